@@ -24,22 +24,106 @@
 
 #include "mega/utils.h"
 
+#include <algorithm>
+
 namespace mega {
 
 // maps attribute names to attribute values
-struct attr_map : map<nameid, string>
+// Nodes rarely carry more than a handful of attributes, but the hot paths
+// (displayname, setattr, fingerprinting) look them up constantly, so the
+// entries are kept in a sorted flat vector: at these sizes a couple of
+// compares in one cache line beat a red-black tree walk.  Iteration order
+// (ascending nameid) matches the previous std::map, so serialized output
+// is unchanged.
+struct attr_map
 {
+    typedef std::pair<nameid, string> value_type;
+    typedef vector<value_type> storage_type;
+    typedef storage_type::iterator iterator;
+    typedef storage_type::const_iterator const_iterator;
+    typedef storage_type::size_type size_type;
+
     attr_map() {}
 
     attr_map(nameid key, string value)
     {
-        (*this)[key] = value;
+        mEntries.emplace_back(key, std::move(value));
     }
 
     attr_map(map<nameid, string>&& m)
     {
-        m.swap(*this);
+        mEntries.reserve(m.size());
+        for (auto& e : m)
+        {
+            mEntries.emplace_back(e.first, std::move(e.second));
+        }
+        m.clear();
+    }
+
+    iterator begin() { return mEntries.begin(); }
+    iterator end() { return mEntries.end(); }
+    const_iterator begin() const { return mEntries.begin(); }
+    const_iterator end() const { return mEntries.end(); }
+
+    size_type size() const { return mEntries.size(); }
+    bool empty() const { return mEntries.empty(); }
+    void clear() { mEntries.clear(); }
+
+    iterator find(nameid key)
+    {
+        iterator it = lowerBound(key);
+        return it != mEntries.end() && it->first == key ? it : mEntries.end();
     }
+
+    const_iterator find(nameid key) const
+    {
+        const_iterator it = lowerBound(key);
+        return it != mEntries.end() && it->first == key ? it : mEntries.end();
+    }
+
+    string& operator[](nameid key)
+    {
+        iterator it = lowerBound(key);
+        if (it == mEntries.end() || it->first != key)
+        {
+            it = mEntries.insert(it, value_type(key, string()));
+        }
+        return it->second;
+    }
+
+    bool operator==(const attr_map& o) const { return mEntries == o.mEntries; }
+    bool operator!=(const attr_map& o) const { return mEntries != o.mEntries; }
+
+    iterator erase(iterator it) { return mEntries.erase(it); }
+
+    size_type erase(nameid key)
+    {
+        iterator it = find(key);
+        if (it == mEntries.end())
+        {
+            return 0;
+        }
+        mEntries.erase(it);
+        return 1;
+    }
+
+private:
+    struct KeyLess
+    {
+        bool operator()(const value_type& e, nameid key) const { return e.first < key; }
+    };
+
+    iterator lowerBound(nameid key)
+    {
+        return std::lower_bound(mEntries.begin(), mEntries.end(), key, KeyLess());
+    }
+
+    const_iterator lowerBound(nameid key) const
+    {
+        return std::lower_bound(mEntries.begin(), mEntries.end(), key, KeyLess());
+    }
+
+    storage_type mEntries;
 };
 
 struct MEGA_API AttrMap
@@ -91,6 +91,47 @@ private:
     CryptoPP::GCM<CryptoPP::AES>::Encryption aesgcm_e;
     CryptoPP::GCM<CryptoPP::AES>::Decryption aesgcm_d;
 
+    // Modes whose AES key schedule matches the current key.  setkey() only
+    // records the raw key; each mode (re)runs its key schedule lazily on
+    // first use, as most cipher objects only ever exercise one or two of
+    // the ten mode instances above.
+    enum
+    {
+        KEYED_ECB_E = 1 << 0,
+        KEYED_ECB_D = 1 << 1,
+        KEYED_CBC_E = 1 << 2,
+        KEYED_CBC_D = 1 << 3,
+        KEYED_CCM8_E = 1 << 4,
+        KEYED_CCM8_D = 1 << 5,
+        KEYED_CCM16_E = 1 << 6,
+        KEYED_CCM16_D = 1 << 7,
+        KEYED_GCM_E = 1 << 8,
+        KEYED_GCM_D = 1 << 9,
+    };
+
+    unsigned keyedModes = 0;
+
+    // run the key schedule for a mode if it doesn't match the current key yet
+    template<typename Mode>
+    void ensureKeyed(Mode& mode, unsigned bit)
+    {
+        if (!(keyedModes & bit))
+        {
+            mode.SetKey(key, KEYLENGTH);
+            keyedModes |= bit;
+        }
+    }
+
+    template<typename Mode>
+    void ensureKeyedWithIV(Mode& mode, unsigned bit)
+    {
+        if (!(keyedModes & bit))
+        {
+            mode.SetKeyWithIV(key, KEYLENGTH, zeroiv);
+            keyedModes |= bit;
+        }
+    }
+
     /**
      * @brief Authenticated symmetric encryption using AES in GCM mode.
      *
@@ -57,6 +57,11 @@ protected:
     bool mCheckAlwaysTransacted = false;
     DBTableTransactionCommitter* mTransactionCommitter = nullptr;
     DBErrorCallback mDBErrorCallBack;
+
+    // scratch buffer for put(): bulk flushes serialize thousands of records
+    // back-to-back, and reusing one buffer keeps its capacity across them
+    // (tables are only ever used from their owning thread)
+    string mPutScratch;
     friend class DBTableTransactionCommitter;
     void checkTransaction();
     // should be called by the subclass' destructor
@@ -177,6 +177,10 @@ struct SyncTransfer_inClient: public File
     // Why was the transfer failed/terminated?
     error mError = API_OK;
 
+    // GET or PUT, set by the subclass constructors; lets hot paths tell the
+    // two apart without a dynamic_cast
+    direction_t direction = NONE;
+
     bool wasTerminated = false;
     bool wasCompleted = false;
     bool wasRequesterAbandoned = false;
@@ -228,6 +228,13 @@ public:
 public:
     LocalPath() {}
 
+    // Heap LocalPaths are slab-pooled: in practice they are the per-node
+    // shortname holders, allocated once per node on Windows, so pooling
+    // them avoids the general allocator's per-object overhead and keeps
+    // them contiguous.  By-value and container uses are unaffected.
+    void* operator new(size_t);
+    void operator delete(void*);
+
 #ifdef _WIN32
     typedef wchar_t separator_t;
     const static separator_t localPathSeparator = L'\\';
@@ -246,6 +253,11 @@ public:
     // returns the internal representation copied into a string buffer, for backward compatibility
     string platformEncoded() const;
 
+    // serialize the platform-encoded form straight into the writer; on
+    // non-Windows the stored bytes already are that form, so no temporary
+    // string is materialised (hot during sync DB snapshots)
+    void serializePlatformEncoded(CacheableWriter& w) const;
+
     bool empty() const;
     void clear();
     void truncate(size_t bytePos);
@@ -335,6 +347,15 @@ public:
     bool operator!=(const LocalPath& p) const { return localpath != p.localpath; }
     bool operator<(const LocalPath& p) const { return localpath < p.localpath; }
 
+    // hash of the raw path bytes, so LocalPath can key unordered containers
+    size_t hash() const { return std::hash<string_type>()(localpath); }
+
+    // length in native characters, for pre-sizing buffers before appends
+    size_t rawSize() const { return localpath.size(); }
+
+    // pre-allocate room for numChars native characters
+    void reserve(size_t numChars) { localpath.reserve(numChars); }
+
     // Try to avoid using this function as much as you can.
     //
     // It's present for efficiency reasons and is really only meant for
@@ -346,6 +367,11 @@ public:
     }
 };
 
+struct LocalPathHash
+{
+    size_t operator()(const LocalPath& p) const { return p.hash(); }
+};
+
 inline std::ostream& operator<<(std::ostream& os, const LocalPath& p)
 {
     return os << p.toPath(false);
@@ -707,6 +733,10 @@ struct MEGA_API FileAccess
     // absolute position write
     virtual bool fwrite(const byte *, unsigned, m_off_t) = 0;
 
+    // hint the OS that a just-written range won't be re-read by us, so it may drop
+    // it from its file cache.  Purely advisory; the default does nothing.
+    virtual void fadviseDontNeed(m_off_t, m_off_t) { }
+
     // Truncate a file.
     virtual bool ftruncate() = 0;
 
@@ -845,6 +875,10 @@ public:
 // For directoryScan(...).
 struct MEGA_API FSNode;
 
+// Prior-scan data passed to directoryScan(), keyed by leaf name.
+// Only ever point-queried, so a hash map avoids the ordered-tree overhead.
+typedef unordered_map<LocalPath, FSNode, LocalPathHash> fsnode_map;
+
 // generic host filesystem access interface
 struct MEGA_API FileSystemAccess : public EventTrigger
 {
@@ -971,7 +1005,7 @@ struct MEGA_API FileSystemAccess : public EventTrigger
 
     virtual ScanResult directoryScan(const LocalPath& path,
                                      handle expectedFsid,
-                                     map<LocalPath, FSNode>& known,
+                                     fsnode_map& known,
                                      std::vector<FSNode>& results,
                                      bool followSymLinks,
                                      unsigned& nFingerprinted) = 0;
@@ -1139,7 +1173,7 @@ public:
             bool followSymlinks,
             LocalPath targetPath,
             handle expectedFsid,
-            map<LocalPath, FSNode>&& priorScanChildren);
+            fsnode_map&& priorScanChildren);
 
         MEGA_DISABLE_COPY_MOVE(ScanRequest);
 
@@ -1176,7 +1210,7 @@ public:
         const bool mFollowSymLinks;
 
         // Details the known children of mTarget.
-        map<LocalPath, FSNode> mKnown;
+        fsnode_map mKnown;
 
         // Results of the scan.
         vector<FSNode> mResults;
@@ -1193,7 +1227,7 @@ public:
     using RequestPtr = std::shared_ptr<ScanRequest>;
 
     // Issue a scan for the given target.
-    RequestPtr queueScan(LocalPath targetPath, handle expectedFsid, bool followSymlinks, map<LocalPath, FSNode>&& priorScanChildren, shared_ptr<Waiter> waiter);
+    RequestPtr queueScan(LocalPath targetPath, handle expectedFsid, bool followSymlinks, fsnode_map&& priorScanChildren, shared_ptr<Waiter> waiter);
 
     // Track performance (debug only)
     static CodeCounter::ScopeStats syncScanTime;
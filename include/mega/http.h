@@ -320,6 +320,15 @@ struct MEGA_API HttpReq
 
     string posturl;
 
+    // true when posturl uses the plain http scheme.  Maintained by setreq, so
+    // the per-chunk transfer handlers don't re-examine the URL on every response
+    bool isHttp = false;
+
+    // true when the response Content-Type is text/html (the storage servers
+    // only return HTML for proxy/captive-portal interference).  Maintained by
+    // the network backend alongside contenttype
+    bool contentTypeIsHtml = false;
+
     bool protect; // check pinned public key
     bool minspeed;
     bool mExpectRedirect = false;
@@ -342,6 +351,10 @@ struct MEGA_API HttpReq
     byte* buf;
     m_off_t buflen, bufpos, notifiedbufpos;
 
+    // allocated capacity of buf; chunk downloads on a connection reuse the
+    // buffer across prepare() calls whenever the capacity suffices
+    m_off_t bufcap = 0;
+
     // When did a post() start
     std::chrono::steady_clock::time_point postStartTime;
 
@@ -392,11 +405,18 @@ struct MEGA_API HttpReq
         size_t start;
         size_t end;
 
-        http_buf_t(byte* b, size_t s, size_t e);  // takes ownership of the byte*, which must have been allocated with new[]
+        http_buf_t(byte* b, size_t s, size_t e);  // takes ownership of the byte*, which must have been allocated with allocbuf()
         ~http_buf_t();
         void swap(http_buf_t& other);
         bool isNull() const;
 
+        // backing store for download chunk buffers.  Blocks cycle between
+        // HttpReqDL and FilePiece many times per transfer, so they are
+        // recycled through a size-keyed pool instead of hitting the heap
+        // for every chunk
+        static byte* allocbuf(size_t n);
+        static void freebuf(byte* p);
+
     private:
         byte* buf;
     };
@@ -1241,6 +1241,10 @@ public:
     // finish downloaded chunks in order
     bool orderdownloadedchunks;
 
+    // hint the OS to drop downloaded data from its file cache as it is written
+    // (for apps doing large downloads that won't be re-read)
+    bool dropwrittenchunkcache;
+
     // retry API_ESSL errors
     bool retryessl;
 
@@ -29,10 +29,19 @@
 #include "syncfilter.h"
 #include "backofftimer.h"
 #include <bitset>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace mega {
 
-typedef map<LocalPath, LocalNode*> localnode_map;
+// Child lookups (childbyname, move detection) run constantly during sync
+// recursion, so children/schildren are hashed rather than tree-ordered;
+// code that needs name order sorts explicitly (see computeSyncTriplets).
+// A vector+index hybrid would iterate slightly faster still, but every
+// add/remove path (setnameparent and friends) would then maintain two
+// structures - the hash map already avoids the per-node pointer chasing
+// of the old red-black tree, which was the expensive part.
+typedef unordered_map<LocalPath, LocalNode*, LocalPathHash> localnode_map;
 
 struct MEGA_API NodeCore
 {
@@ -109,6 +118,10 @@ struct MEGA_API PublicLink
     PublicLink(handle ph, m_time_t cts, m_time_t ets, bool takendown, const char *authKey = nullptr);
     PublicLink(const PublicLink& plink) = default;
 
+    // instances are slab-pooled (see node.cpp)
+    void* operator new(size_t);
+    void operator delete(void*);
+
     bool isExpired();
 };
 
@@ -126,8 +139,47 @@ struct NodeCounter
     NodeCounter() = default;
 };
 
-typedef std::multiset<FileFingerprint*, FileFingerprintCmp> fingerprint_set;
-typedef fingerprint_set::iterator FingerprintPosition;
+// Fingerprint lookups (nodebyfingerprint, dedup on upload) are pure
+// equal_range queries, so the container is hashed.  Hash and equality use
+// the exact size/mtime/crc triple - the same equivalence the ordered
+// comparator induced.
+struct FileFingerprintHash
+{
+    // splitmix64 finalizer: two multiply-xorshift rounds, branch-free
+    static uint64_t mix(uint64_t v)
+    {
+        v += 0x9e3779b97f4a7c15ull;
+        v = (v ^ (v >> 30)) * 0xbf58476d1ce4e5b9ull;
+        v = (v ^ (v >> 27)) * 0x94d049bb133111ebull;
+        return v ^ (v >> 31);
+    }
+
+    std::size_t operator()(const FileFingerprint* fp) const
+    {
+        // consume the fingerprint as four 64-bit lanes (size, mtime, and the
+        // four crc words packed pairwise) rather than word by word
+        const uint64_t crc01 = (static_cast<uint64_t>(static_cast<uint32_t>(fp->crc[0])) << 32)
+                               | static_cast<uint32_t>(fp->crc[1]);
+        const uint64_t crc23 = (static_cast<uint64_t>(static_cast<uint32_t>(fp->crc[2])) << 32)
+                               | static_cast<uint32_t>(fp->crc[3]);
+
+        uint64_t h = mix(static_cast<uint64_t>(fp->size));
+        h = mix(h ^ static_cast<uint64_t>(fp->mtime));
+        h = mix(h ^ crc01);
+        h = mix(h ^ crc23);
+        return static_cast<std::size_t>(h);
+    }
+};
+
+struct FileFingerprintEqual
+{
+    bool operator()(const FileFingerprint* a, const FileFingerprint* b) const
+    {
+        return a->size == b->size && a->mtime == b->mtime && a->crc == b->crc;
+    }
+};
+
+typedef std::unordered_multiset<FileFingerprint*, FileFingerprintHash, FileFingerprintEqual> fingerprint_set;
 
 
 class NodeManagerNode
@@ -146,7 +198,10 @@ private:
     NodeManager& mNodeManager;
     shared_ptr<Node> mNode;
 };
-typedef std::map<NodeHandle, NodeManagerNode>::iterator NodePosition;
+// Nodes are indexed by a node-based (separately chained) hash table keyed on
+// NodeHandle (NodeManager::mNodes); cached positions are plain element
+// pointers, which unordered_map keeps stable across rehashes.
+typedef NodeManagerNode* NodePosition;
 
 struct CommandChain
 {
@@ -345,7 +400,8 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     } changed;
 
 
-    void setKey(const string& key);
+    // takes the key by value so bulk load sites can move it in without a copy
+    void setKey(string key);
     void setkey(const byte*);
     void setkeyfromjson(const char*);
 
@@ -359,13 +415,14 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     // parent
     shared_ptr<Node> parent;
 
-    // own position in NodeManager::mFingerPrints (only valid for file nodes)
-    // It's used for speeding up node removing at NodeManager::removeFingerprint
-    FingerprintPosition mFingerPrintPosition;
+    // whether this node has an entry in NodeManager::mFingerPrints (only
+    // meaningful for file nodes).  The hashed container invalidates
+    // iterators on rehash, so removal re-finds the entry by equal_range.
+    bool mFingerPrintInContainer = false;
     // own position in NodeManager::mNodes. The map can have an element of type NodeManagerNode
     // previously Node exists
     // It's used for speeding up get children when Node parent is known
-    NodePosition mNodePosition;
+    NodePosition mNodePosition = nullptr;
 
     // check if node is below this node
     bool isbelow(Node*) const;
@@ -382,6 +439,12 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     Node(MegaClient&, NodeHandle, NodeHandle, nodetype_t, m_off_t, handle, const char*, m_time_t);
     ~Node();
 
+    // Nodes are created and destroyed in huge numbers while (re)loading large
+    // accounts, so they are carved out of dedicated slabs instead of hitting
+    // the general-purpose heap for every object.
+    void* operator new(size_t);
+    void operator delete(void*);
+
     int getShareType() const;
 
     bool isAncestor(NodeHandle ancestorHandle) const;
@@ -446,6 +509,16 @@ private:
     // cooked if size() == FOLDERNODEKEYLENGTH or FILEFOLDERNODEKEYLENGTH)
     string nodekeydata;
 
+    // cached result of keyApplied(); the few places that modify nodekeydata
+    // (setKey() and applykey()) refresh it, so the hot query is a plain load
+    bool mKeyApplied = false;
+
+    // recompute mKeyApplied after a change to nodekeydata
+    void updateKeyApplied()
+    {
+        mKeyApplied = nodekeydata.size() == size_t((type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH);
+    }
+
     // keeps track of counts of files, folder, versions, storage and version's storage
     NodeCounter mCounter;
 
@@ -454,7 +527,7 @@ private:
 
 inline const string& Node::nodekey() const
 {
-    assert(keyApplied() || type == ROOTNODE || type == VAULTNODE || type == RUBBISHNODE);
+    assert(keyApplied() || isRootNodeType(type));
     return nodekeydata;
 }
 
@@ -465,7 +538,7 @@ inline const string& Node::nodekeyUnchecked() const
 
 inline bool Node::keyApplied() const
 {
-    return nodekeydata.size() == size_t((type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH);
+    return mKeyApplied;
 }
 
 #ifdef ENABLE_SYNC
@@ -509,6 +582,10 @@ struct MEGA_API LocalNodeCore
     // If not synced then it's the to-local (escaped) version of the CloudNode's name
     // This is also the key in the parent LocalNode's children map
     // (if this is the sync root node, it is an absolute path - otherwise just a leaf name)
+    // Stored per node rather than interned in a shared table: the name is
+    // mutated in place on rename, serialized with the node, and fed to
+    // platform-specific compares, so a handle-into-pool scheme would
+    // complicate all of those for a modest memory saving on leaf strings.
     LocalPath localname;
 
     // for botched filesystems with legacy secondary ("short") names
@@ -541,7 +618,9 @@ struct MEGA_API LocalNode
 
     // UTF8 NFC version of LocalNodeCore::localname.
     // Not serialized.
-    // Should be updated whenever localname is.
+    // Should be updated whenever localname is (setnameparent does this),
+    // which makes the cloud-name conversion per-rename rather than
+    // per-exclusion-check in the filter ancestor walks.
     // Does not match the corresponding Node's name,
     // as escapes/case may be involved.
     string toName_of_localname;
@@ -555,25 +634,25 @@ struct MEGA_API LocalNode
     unique_ptr<LocalPath> cloneShortname() const;
     localnode_map schildren;
 
-    // The last scan of the folder (for folders).
-    // Removed again when the folder is fully synced.
-    std::unique_ptr<vector<FSNode>> lastFolderScan;
-
     // If we can regenerate the filsystem data at this node, no need to store it, save some RAM
     void clearRegeneratableFolderScan(SyncPath& fullPath, vector<SyncRow>& childRows);
 
-    fsid_localnode_map::iterator fsid_lastSynced_it;
+    // whether this node has an entry in Syncs::localnodeBySyncedFsid
+    // (the hashed multimaps invalidate iterators on rehash, so we track
+    // membership and erase by equal_range scan instead of a cached iterator)
+    bool fsid_lastSynced_inMap = false;
 
     // we also need to track what fsid corresponded to our FSNode last time, even if not synced (not serialized)
     // if it changes, we should rescan, in case of LocalNode pre-existing with no FSNode, then one appears.  Or, now it's different
     handle fsid_asScanned = ::mega::UNDEF;
-    fsid_localnode_map::iterator fsid_asScanned_it;
+    // whether this node has an entry in Syncs::localnodeByScannedFsid
+    bool fsid_asScanned_inMap = false;
 
     // Fingerprint of the file as of the last scan.  TODO: does this make LocalNode too large?
     FileFingerprint scannedFingerprint;
 
-    // related cloud node, if any
-    nodehandle_localnode_map::iterator syncedCloudNodeHandle_it;
+    // whether this node has an entry in Syncs::localnodeByNodeHandle
+    bool syncedCloudNodeHandle_inMap = false;
 
     // using a per-Localnode scan delay prevents self-notifications delaying the whole sync
     dstime scanDelayUntil = 0;
@@ -752,8 +831,18 @@ struct MEGA_API LocalNode
         // Filter rules applicable below this node.
         unique_ptr<FilterChain> filterChain;
 
+        // The last scan of the folder (for folders).
+        // Removed again when the folder is fully synced, so only folders
+        // with scans actually in progress pay for the storage.
+        std::unique_ptr<vector<FSNode>> lastFolderScan;
+
         // If we can tell what the filesystem renamed a downloaded file to
         LocalPath localFSRenamedToThisName;
+
+        // flags-heavy syncs create and drop these constantly, so they come
+        // from the same slab scheme as LocalNode itself (see node.cpp)
+        void* operator new(size_t);
+        void operator delete(void*);
     };
 
     bool hasRare() { return !!rareFields; }
@@ -819,6 +908,7 @@ struct MEGA_API LocalNode
 
     FSNode getLastSyncedFSDetails() const;
     FSNode getScannedFSDetails() const;
+    bool scannedFSDetailsEquivalentTo(const FSNode& n) const;
 
     // Each LocalNode can be either uploading or downloading a file.
     // These functions manage that
@@ -843,6 +933,10 @@ struct MEGA_API LocalNode
     LocalNode(Sync*);
     void init(nodetype_t, LocalNode*, const LocalPath&, std::unique_ptr<LocalPath>);
 
+    // instances are slab-pooled (see node.cpp)
+    void* operator new(size_t);
+    void operator delete(void*);
+
     bool serialize(string*) const override;
     static unique_ptr<LocalNode> unserialize(Sync& sync, const string& source, uint32_t& parentID);
 
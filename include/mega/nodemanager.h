@@ -24,6 +24,7 @@
 #define NODEMANAGER_H 1
 
 #include <map>
+#include <unordered_map>
 #include <set>
 #include "node.h"
 #include "types.h"
@@ -159,6 +160,10 @@ public:
     // Hint: ensure all children are loaded if this method is called for all children of a folder
     std::shared_ptr<Node> childNodeByNameType(const Node *parent, const std::string& name, nodetype_t nodeType);
 
+    // As above but matches FILENODE and FOLDERNODE children in a single pass,
+    // with folder matches taking precedence (avoids scanning the children twice)
+    std::shared_ptr<Node> childNodeByNameFolderFirst(const Node *parent, const std::string& name);
+
     // Returns ROOTNODE, INCOMINGNODE, RUBBISHNODE (In case of logged into folder link returns only ROOTNODE)
     // Load from DB if it's necessary
     sharedNode_vector getRootNodes();
@@ -232,11 +237,10 @@ public:
     bool setrootnode(std::shared_ptr<Node> node);
 
     // Add fingerprint to mFingerprint. If node isn't going to keep in RAM
-    // node isn't added
-    FingerprintPosition insertFingerprint(Node* node);
+    // node isn't added.  Returns whether the node was added.
+    bool insertFingerprint(Node* node);
     // Remove fingerprint from mFingerprint
     void removeFingerprint(Node* node, bool unloadNode = false);
-    FingerprintPosition invalidFingerprintPos();
 
     // Node has received last updates and it's ready to store in DB
     void saveNodeInDb(Node *node);
@@ -304,6 +308,9 @@ private:
         void clear();
     } rootnodes;
 
+    // In-memory cache over the fingerprint index kept in the DB.  It is
+    // filled lazily, one fingerprint lookup at a time, so there is no bulk
+    // build phase at login that would benefit from parallel ingestion.
     class FingerprintContainer : public fingerprint_set
     {
     public:
@@ -319,7 +326,9 @@ private:
     };
 
     // Stores nodes that have been loaded in RAM from DB (not necessarily all of them)
-    std::map<NodeHandle, NodeManagerNode> mNodes;
+    // Hashed by handle: bulk load and nodebyhandle() hit this once per node,
+    // so O(1) lookups beat the red-black tree walk at account scale
+    std::unordered_map<NodeHandle, NodeManagerNode, NodeHandleHash> mNodes;
 
     uint64_t mNodesInRam = 0;
 
@@ -349,7 +358,8 @@ private:
     shared_ptr<Node> unserializeNode(const string*, bool fromOldCache);
 
     // returns the counter for the specified node, calculating it recursively and accessing to DB if it's neccesary
-    NodeCounter calculateNodeCounter(const NodeHandle &nodehandle, nodetype_t parentType, std::shared_ptr<Node> node, bool isInRubbish);
+    // nmNode is the node's position in mNodes, if already known (avoids a lookup per visited node)
+    NodeCounter calculateNodeCounter(const NodeHandle &nodehandle, nodetype_t parentType, std::shared_ptr<Node> node, bool isInRubbish, NodeManagerNode* nmNode = nullptr);
 
     // Container storing FileFingerprint* (Node* in practice) ordered by fingerprint
     FingerprintContainer mFingerPrints;
@@ -412,6 +422,7 @@ private:
     sharedNode_vector getNodesByOrigFingerprint_internal(const std::string& fingerprint, Node *parent);
     std::shared_ptr<Node> getNodeByFingerprint_internal(FileFingerprint &fingerprint);
     std::shared_ptr<Node> childNodeByNameType_internal(const Node *parent, const std::string& name, nodetype_t nodeType);
+    std::shared_ptr<Node> childNodeByNameFolderFirst_internal(const Node *parent, const std::string& name);
     sharedNode_vector getRootNodes_internal();
 
     /** @deprecated */
@@ -433,7 +444,7 @@ private:
     NodeCounter getCounterOfRootNodes_internal();
     void updateCounter_internal(std::shared_ptr<Node> n, std::shared_ptr<Node> oldParent);
     bool setrootnode_internal(std::shared_ptr<Node> node);
-    FingerprintPosition insertFingerprint_internal(Node* node);
+    bool insertFingerprint_internal(Node* node);
     void removeFingerprint_internal(Node* node, bool unloadNode);
     void saveNodeInDb_internal(Node *node);
     void dumpNodes_internal();
@@ -115,7 +115,7 @@ public:
 
     ScanResult directoryScan(const LocalPath& path,
                              handle expectedFsid,
-                             map<LocalPath, FSNode>& known,
+                             fsnode_map& known,
                              std::vector<FSNode>& results,
                              bool followSymLinks,
                              unsigned& nFingerprinted) override;
@@ -162,6 +162,8 @@ public:
     bool fread(string *, unsigned, unsigned, m_off_t);
     bool fwrite(const byte *, unsigned, m_off_t) override;
 
+    void fadviseDontNeed(m_off_t offset, m_off_t len) override;
+
     bool ftruncate() override;
 
     bool sysread(byte *, unsigned, m_off_t) override;
@@ -45,6 +45,7 @@
 #include <sstream>
 #include <fstream>
 #include <map>
+#include <unordered_map>
 #include <deque>
 #include <set>
 #include <iterator>
@@ -31,6 +31,9 @@ namespace mega {
     enum { RAIDSECTOR = 16 };
     enum { RAIDLINE = ((RAIDPARTS - 1)*RAIDSECTOR) };
 
+    // sector alignment below relies on masking
+    static_assert((RAIDSECTOR & (RAIDSECTOR - 1)) == 0, "RAIDSECTOR must be a power of two");
+
 
     // Holds the latest download data received.   Raid-aware.   Suitable for file transfers, or direct streaming.
     // For non-raid files, supplies the received buffer back to the same connection for writing to file (having decrypted and mac'd it),
@@ -43,12 +46,16 @@ namespace mega {
     public:
 
         struct FilePiece {
+            // heap instances come and go with every completed chunk, so they
+            // are slab-pooled (see raid.cpp)
+            void* operator new(size_t size);
+            void operator delete(void* p);
+
             m_off_t pos;
             HttpReq::http_buf_t buf;  // owned here
             chunkmac_map chunkmacs;
 
-            std::condition_variable finalizedCV;
-            bool finalized = false;
+            std::atomic<bool> finalized{false};
 
             FilePiece();
             FilePiece(m_off_t p, size_t len);    // makes a buffer of the specified size (with extra space for SymmCipher::ctr_crypt padding)
@@ -103,6 +110,15 @@ namespace mega {
         // temp URL to use on a given connection.  The same on all connections for a non-raid file.
         const std::string& tempURL(unsigned connectionNum);
 
+        // the same URL with ":8080" already spliced in after the host, for the alternative-port
+        // workaround.  Prebuilt when the URLs are set, so the port-toggle paths don't re-parse
+        // the URL per chunk.  Identical to tempURL() for https or explicit-port URLs.
+        const std::string& tempURLWithAltPort(unsigned connectionNum);
+
+        // shareable reference to either URL variant, for capture into async jobs that may
+        // outlive this object.  Avoids a deep copy of the URL per queued job.
+        std::shared_ptr<const std::string> tempURLShared(unsigned connectionNum, bool altPort);
+
         // reference to the tempurls.  Useful for caching raid and non-raid
         const std::vector<std::string>& tempUrlVector() const;
 
@@ -160,8 +176,16 @@ namespace mega {
 
         // storage server access URLs.  It either has 6 entries for a raid file, or 1 entry for a non-raid file, or empty if we have not looked up a tempurl yet.
         std::vector<std::string> tempurls;
+
+        // shareable copies of the URLs, plain and with the alternative port inserted where
+        // applicable (kept in step with tempurls)
+        std::vector<std::shared_ptr<const std::string>> tempurlsShared;
+        std::vector<std::shared_ptr<const std::string>> tempurlsAltPortShared;
         std::string emptyReturnString;
 
+        // rebuild the shared URL variants from tempurls
+        void buildAltPortUrls();
+
         // a connection is paused if it reads too far ahead of others.  This prevents excessive buffer usage
         bool connectionPaused[RAIDPARTS];
 
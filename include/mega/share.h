@@ -45,6 +45,10 @@ struct MEGA_API Share
     static NewShare* unserialize(int, handle, const byte *, const char**, const char*);
 
     Share(User*, accesslevel_t, m_time_t, PendingContactRequest* = NULL);
+
+    // instances are slab-pooled (see share.cpp)
+    void* operator new(size_t);
+    void operator delete(void*);
 };
 
 // new share credentials (will be merged into node as soon as it appears)
@@ -64,6 +68,10 @@ struct MEGA_API NewShare
     byte auth[SymmCipher::BLOCKSIZE];
 
     NewShare(handle, int, handle, accesslevel_t, m_time_t, const byte*, const byte* = NULL, handle = UNDEF, bool = false, bool = false);
+
+    // instances are slab-pooled (see share.cpp)
+    void* operator new(size_t);
+    void operator delete(void*);
 };
 
 } // namespace
@@ -174,6 +174,12 @@ public:
     // Attempts to locate a match for the size s.
     ExclusionState match(const m_off_t s) const;
 
+    // Whether matching with onlyInheritable set could ever succeed.
+    // Lets ancestor walks skip chains whose rules all stop at their own
+    // directory.  True for unloaded chains, which must still report
+    // ES_UNKNOWN when consulted.
+    bool hasInheritableRules() const;
+
     // Fingerprint of the last loaded ignore file.
     FileFingerprint mFingerprint;
     bool mLoadSucceeded = false;
@@ -186,6 +192,9 @@ private:
 
     // File size filter.
     SizeFilterPtr mSizeFilter;
+
+    // Cached at load: any string filter marked inheritable?
+    bool mHasInheritableRules = false;
 }; /* FilterChain */
 
 class IgnoreFileName
@@ -103,14 +103,15 @@ struct MEGA_API TransferSlot
     // Manage download input buffers and file output buffers for file download.  Raid-aware, and automatically performs decryption and mac.
     TransferBufferManager transferbuf;
 
-    // async IO operations
-    AsyncIOContext** asyncIO;
+    // async IO operations, one slot per connection (the contexts themselves
+    // are platform-specific objects created by the FileAccess factories)
+    vector<AsyncIOContext*> asyncIO;
 
     // handle I/O for this slot
     void doio(MegaClient*, TransferDbCommitter&);
 
     // Prepare an HTTP request
-    void prepareRequest(const std::shared_ptr<HttpReqXfer>&, const string& tempURL, m_off_t pos, m_off_t npos);
+    void prepareRequest(const std::shared_ptr<HttpReqXfer>&, unsigned connectionNum, m_off_t pos, m_off_t npos);
 
     // Process a request failure
     // Return values:
@@ -132,7 +133,6 @@ struct MEGA_API TransferSlot
 
     // compute the meta MAC based on the chunk MACs
     int64_t macsmac(chunkmac_map*);
-    int64_t macsmac_gaps(chunkmac_map*, size_t g1, size_t g2, size_t g3, size_t g4);
 
     // tslots list position
     transferslot_list::iterator slots_it;
@@ -149,8 +149,20 @@ struct MEGA_API TransferSlot
 
 private:
     void toggleport(HttpReqXfer* req);
-    bool checkDownloadTransferFinished(TransferDbCommitter& committer, MegaClient* client);
+    bool checkDownloadTransferFinished(TransferDbCommitter& committer, MegaClient* client, bool cachedDownload = false);
     bool checkMetaMacWithMissingLateEntries();
+
+    // completed but out-of-order download chunks (orderdownloadedchunks mode), keyed by
+    // file position, parked until progresscompleted catches up to them
+    map<m_off_t, unsigned> mParkedChunks;
+
+    // chunk completions that need the Transfer re-serialised to the cache, coalesced
+    // into a single transfercacheadd per doio() pass instead of one per chunk
+    bool mCacheAddPending = false;
+
+    // resume the parked chunk (if any) starting at the current download progress
+    // point; returns its connection number, or -1 if there is none
+    int unparkDownloadChunk();
     bool tryRaidRecoveryFromHttpGetError(unsigned i, bool incrementErrors);
 
     // returns true if connection haven't received data recently (set incrementErrors) or if slower than other connections (reset incrementErrors)
@@ -87,6 +87,8 @@ using std::list;
 using std::vector;
 using std::pair;
 using std::multimap;
+using std::unordered_map;
+using std::unordered_multimap;
 using std::deque;
 using std::multiset;
 using std::queue;
@@ -166,7 +168,7 @@ typedef uint32_t dstime;
 typedef enum { REQ_READY, REQ_GET_URL, REQ_PREPARED, REQ_UPLOAD_PREPARED_BUT_WAIT,
                REQ_ENCRYPTING, REQ_DECRYPTING, REQ_DECRYPTED,
                REQ_INFLIGHT,
-               REQ_SUCCESS, REQ_FAILURE, REQ_DONE, REQ_ASYNCIO,
+               REQ_SUCCESS, REQ_PARKED, REQ_FAILURE, REQ_DONE, REQ_ASYNCIO,
                } reqstatus_t;
 
 typedef enum { USER_HANDLE, NODE_HANDLE } targettype_t;
@@ -290,6 +292,12 @@ inline bool operator!=(NodeHandle a, handle b) { return a.ne(b); }
 inline bool operator!=(NodeHandle a, NodeHandle b) { return a.ne(b); }
 std::ostream& operator<<(std::ostream&, NodeHandle h);
 
+// for use as a key in unordered containers
+struct NodeHandleHash
+{
+    std::size_t operator()(NodeHandle nh) const { return std::hash<uint64_t>()(nh.as8byte()); }
+};
+
 struct UploadHandle
 {
     handle h = 0xFFFFFFFFFFFFFFFF;
@@ -352,6 +360,13 @@ typedef enum {
     RUBBISHNODE,     // RUBBISH - rubbish bin
 } nodetype_t;
 
+// ROOTNODE, VAULTNODE and RUBBISHNODE are contiguous, so testing for "any of
+// the three root types" collapses to a single range check
+inline bool isRootNodeType(nodetype_t t)
+{
+    return t >= ROOTNODE && t <= RUBBISHNODE;
+}
+
 enum class TypeOfLink {
     FOLDER,
     FILE,
@@ -531,11 +546,13 @@ typedef vector<LocalNode*> localnode_vector;
 
 // fsid is not necessarily unique because multiple filesystems may be involved
 // Hence, we use a multimap and check other parameters too when looking for a match.
-typedef multimap<handle, LocalNode*> fsid_localnode_map;
+// Hashed: these are only ever queried by equal_range on a single key, and the
+// lookups run constantly during move detection on scans.
+typedef unordered_multimap<handle, LocalNode*> fsid_localnode_map;
 
 // A similar type for looking up LocalNode by node handle, analagously
 // Keep the type separate by inheriting
-typedef multimap<NodeHandle, LocalNode*> nodehandle_localnode_map;
+typedef unordered_multimap<NodeHandle, LocalNode*, NodeHandleHash> nodehandle_localnode_map;
 
 typedef set<LocalNode*> localnode_set;
 
@@ -261,6 +261,36 @@ std::string winErrorMessage(DWORD error);
 
 #endif
 
+// Slab allocator backing pooled operator new/delete for small objects that
+// are created and destroyed in bulk (nodes and their share/link companions).
+// Idle slots are chained into a free list through their first pointer-sized
+// bytes, so the pool needs no bookkeeping beyond the slab pointers themselves.
+class MEGA_API SlabPool
+{
+    enum { SLOTS_PER_SLAB = 256 };
+
+    struct FreeSlot
+    {
+        FreeSlot* next;
+    };
+
+    size_t slotSize;
+    vector<void*> slabs;
+    FreeSlot* freeHead = nullptr;
+    std::mutex m;
+
+public:
+    explicit SlabPool(size_t objectSize)
+        : slotSize(objectSize < sizeof(FreeSlot) ? sizeof(FreeSlot) : objectSize)
+    {
+    }
+
+    ~SlabPool();
+
+    void* alloc();
+    void release(void* p);
+};
+
 struct MEGA_API TLVstore
 {
 private:
@@ -557,7 +587,40 @@ class chunkmac_map
 
 public:
     int64_t macsmac(SymmCipher *cipher);
-    int64_t macsmac_gaps(SymmCipher *cipher, size_t g1, size_t g2, size_t g3, size_t g4);
+
+    // Precomputed chain state for the MAC gap search in
+    // TransferSlot::checkMetaMacWithMissingLateEntries.  Building it walks the
+    // chain once; a candidate MAC with gaps is then seeded from the state just
+    // before its first gap and only re-encrypts the entries that survive after
+    // it, instead of re-running the entire chain for every candidate.  The
+    // entry macs are referenced, not copied, so the map must not change
+    // between build and the probes.
+    struct MacsmacState
+    {
+        // CBC-MAC state after the first i entries of the chain
+        std::vector<std::array<byte, SymmCipher::BLOCKSIZE>> states;
+
+        // macsmac position of each entry (positions covered by the collapsed
+        // leading record never appear; positions are strictly increasing)
+        std::vector<size_t> positions;
+
+        // the entry macs, in chain order
+        std::vector<const byte*> macs;
+
+        // index of the first entry at or after macsmac position g
+        size_t entryAt(size_t g) const;
+
+        // chain entries [from, to) into mac
+        void fold(SymmCipher* cipher, size_t from, size_t to, byte* mac) const;
+
+        // condense a final chain state into the 64-bit metamac form
+        static int64_t metamac(const byte* mac);
+
+        // MAC of the chain with entries at positions [g1,g2) and [g3,g4) left out
+        int64_t macWithGaps(SymmCipher* cipher, size_t g1, size_t g2, size_t g3, size_t g4) const;
+    };
+
+    void buildMacsmacState(SymmCipher* cipher, MacsmacState& state) const;
     void serialize(string& d) const;
     bool unserialize(const char*& ptr, const char* end);
     void calcprogress(m_off_t size, m_off_t& chunkpos, m_off_t& completedprogress, m_off_t* sumOfPartialChunks = nullptr);
@@ -567,6 +630,9 @@ public:
     void finishedUploadChunks(chunkmac_map& macs);
     bool finishedAt(m_off_t pos);
     m_off_t updateContiguousProgress(m_off_t fileSize);
+    // Fold completed leading chunks into the collapsed macsmacSoFar record as
+    // transfer progress advances, so the final macsmac on token arrival only
+    // chains the bounded uncollapsed tail rather than every chunk of the file.
     void updateMacsmacProgress(SymmCipher *cipher);
     void copyEntriesTo(chunkmac_map& other);
     void copyEntryTo(m_off_t pos, chunkmac_map& other);
@@ -705,7 +771,7 @@ private:
         bool discardable = false;
         std::function<void(SymmCipher&)> f;
         Entry(bool disc, std::function<void(SymmCipher&)>&& func)
-             : discardable(disc), f(func)
+             : discardable(disc), f(std::move(func))
         {}
     };
 
@@ -90,7 +90,7 @@ public:
     static void emptydirlocal(const LocalPath&, dev_t = 0);
 
     ScanResult directoryScan(const LocalPath& path, handle expectedFsid,
-        map<LocalPath, FSNode>& known, std::vector<FSNode>& results, bool followSymlinks, unsigned& nFingerprinted) override;
+        fsnode_map& known, std::vector<FSNode>& results, bool followSymlinks, unsigned& nFingerprinted) override;
 
     WinFileSystemAccess();
     ~WinFileSystemAccess();
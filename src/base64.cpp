@@ -23,6 +23,28 @@
 #include "mega/utils.h"
 
 namespace mega {
+
+namespace {
+
+// 256-entry decode table so the bulk decode loop is a single indexed load per
+// character instead of a call into from64()'s compare chain (255 = invalid)
+struct Base64DecodeTable
+{
+    byte values[256];
+
+    Base64DecodeTable()
+    {
+        for (unsigned i = 0; i < 256; i++)
+        {
+            values[i] = Base64::from64(static_cast<byte>(i));
+        }
+    }
+};
+
+const Base64DecodeTable b64table;
+
+} // anonymous namespace
+
 // modified base64 conversion (no trailing '=' and '-_' instead of '+/')
 unsigned char Base64::to64(byte c)
 {
@@ -101,15 +123,53 @@ std::string Base64::atob(const std::string &in)
 
 int Base64::atob(const char* a, byte* b, int blen)
 {
+    const byte* lut = b64table.values;
+    int p = 0;
+
+    // fast path: decode whole 4-character groups with table lookups only,
+    // leaving truncated/irregular input to the general loop below.
+    // Typical inputs here (upload tokens, handles, keys) are a few dozen
+    // bytes, too short for vectorised decoding to pay for its setup.
+    while (p + 3 <= blen)
+    {
+        byte c0 = lut[static_cast<unsigned char>(a[0])];
+        if (c0 == 255)
+        {
+            break;
+        }
+
+        byte c1 = lut[static_cast<unsigned char>(a[1])];
+        if (c1 == 255)
+        {
+            break;
+        }
+
+        byte c2 = lut[static_cast<unsigned char>(a[2])];
+        if (c2 == 255)
+        {
+            break;
+        }
+
+        byte c3 = lut[static_cast<unsigned char>(a[3])];
+        if (c3 == 255)
+        {
+            break;
+        }
+
+        b[p++] = static_cast<byte>((c0 << 2) | (c1 >> 4));
+        b[p++] = static_cast<byte>((c1 << 4) | (c2 >> 2));
+        b[p++] = static_cast<byte>((c2 << 6) | c3);
+        a += 4;
+    }
+
     byte c[4]={};
     int i;
-    int p = 0;
 
     for (;;)
     {
         for (i = 0; i < 4; i++)
         {
-            if ((c[i] = from64(*a++)) == 255)
+            if ((c[i] = lut[static_cast<unsigned char>(*a++)]) == 255)
             {
                 break;
             }
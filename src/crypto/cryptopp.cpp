@@ -65,6 +65,16 @@ byte SymmCipher::zeroiv[BLOCKSIZE];
 
 void SymmCipher::setkey(const byte* newkey, int type)
 {
+    // re-keying with the key already in use is common (the transfer workers
+    // key their cipher for every chunk of the same transfer); keep the cached
+    // mode schedules in that case.  Only valid for type 1, where the stored
+    // key equals the caller's key rather than a folded derivative of it, and
+    // only once a previous setkey has initialised the key bytes.
+    if (type == 1 && keyedModes && !memcmp(key, newkey, KEYLENGTH))
+    {
+        return;
+    }
+
     memcpy(key, newkey, KEYLENGTH);
 
     if (!type)
@@ -72,20 +82,9 @@ void SymmCipher::setkey(const byte* newkey, int type)
         xorblock(newkey + KEYLENGTH, key);
     }
 
-    aesecb_e.SetKey(key, KEYLENGTH);
-    aesecb_d.SetKey(key, KEYLENGTH);
-
-    aescbc_e.SetKeyWithIV(key, KEYLENGTH, zeroiv);
-    aescbc_d.SetKeyWithIV(key, KEYLENGTH, zeroiv);
-
-    aesccm8_e.SetKeyWithIV(key, KEYLENGTH, zeroiv);
-    aesccm8_d.SetKeyWithIV(key, KEYLENGTH, zeroiv);
-
-    aesccm16_e.SetKeyWithIV(key, KEYLENGTH, zeroiv);
-    aesccm16_d.SetKeyWithIV(key, KEYLENGTH, zeroiv);
-
-    aesgcm_e.SetKeyWithIV(key, KEYLENGTH, zeroiv);
-    aesgcm_d.SetKeyWithIV(key, KEYLENGTH, zeroiv);
+    // invalidate all schedules; each mode re-keys itself on first use, so a
+    // key change costs one schedule per mode actually exercised instead of ten
+    keyedModes = 0;
 }
 
 bool SymmCipher::setkey(const string* key)
@@ -105,6 +104,7 @@ bool SymmCipher::cbc_encrypt_with_key(const std::string& plain, std::string& cip
     try
     {
         aescbc_e.SetKeyWithIV(key, keylen, iv ? iv: zeroiv);
+        keyedModes &= ~unsigned(KEYED_CBC_E);   // schedule no longer matches our own key
         StringSource ss(plain, true, new StreamTransformationFilter(aescbc_e, new StringSink(cipher)));
         return true;
     }
@@ -120,6 +120,7 @@ bool SymmCipher::cbc_decrypt_with_key(const std::string& cipher, std::string& pl
     try
     {
         aescbc_d.SetKeyWithIV(key, keylen, iv ? iv: zeroiv);
+        keyedModes &= ~unsigned(KEYED_CBC_D);   // schedule no longer matches our own key
         StringSource ss(cipher, true, new StreamTransformationFilter(aescbc_d, new StringSink(plain)));
         return true;
     }
@@ -134,6 +135,7 @@ bool SymmCipher::cbc_encrypt(byte* data, size_t len, const byte* iv)
 {
     try
     {
+        ensureKeyedWithIV(aescbc_e, KEYED_CBC_E);
         aescbc_e.Resynchronize(iv ? iv : zeroiv);
         aescbc_e.ProcessData(data, data, len);
         return true;
@@ -149,6 +151,7 @@ bool SymmCipher::cbc_decrypt(byte* data, size_t len, const byte* iv)
 {
     try
     {
+        ensureKeyedWithIV(aescbc_d, KEYED_CBC_D);
         aescbc_d.Resynchronize(iv ? iv : zeroiv);
         aescbc_d.ProcessData(data, data, len);
         return true;
@@ -172,6 +175,8 @@ bool SymmCipher::cbc_encrypt_pkcs_padding(const string *data, const byte *iv, st
 
     try
     {
+        ensureKeyedWithIV(aescbc_e, KEYED_CBC_E);
+
         // Update IV.
         aescbc_e.Resynchronize(iv ? iv : zeroiv);
 
@@ -212,6 +217,8 @@ bool SymmCipher::cbc_decrypt_pkcs_padding(const std::string* data, const byte* i
     {
         using Transformation = StreamTransformationFilter;
 
+        ensureKeyedWithIV(aescbc_d, KEYED_CBC_D);
+
         // Update IV.
         aescbc_d.Resynchronize(iv ? iv : zeroiv);
 
@@ -256,6 +263,8 @@ bool SymmCipher::cbc_decrypt_pkcs_padding(const byte* data,
     {
         using Transformation = StreamTransformationFilter;
 
+        ensureKeyedWithIV(aescbc_d, KEYED_CBC_D);
+
         // Update IV.
         aescbc_d.Resynchronize(iv ? iv : zeroiv);
 
@@ -287,11 +296,13 @@ bool SymmCipher::cbc_decrypt_pkcs_padding(const byte* data,
 
 void SymmCipher::ecb_encrypt(byte* data, byte* dst, size_t len)
 {
+    ensureKeyed(aesecb_e, KEYED_ECB_E);
     aesecb_e.ProcessData(dst ? dst : data, data, len);
 }
 
 void SymmCipher::ecb_decrypt(byte* data, size_t len)
 {
+    ensureKeyed(aesecb_d, KEYED_ECB_D);
     aesecb_d.ProcessData(data, data, len);
 }
 
@@ -307,6 +318,7 @@ bool SymmCipher::ccm_encrypt(const string *data, const byte *iv, unsigned ivlen,
     {
         if (taglen == 16)
         {
+            ensureKeyedWithIV(aesccm16_e, KEYED_CCM16_E);
             aesccm16_e.Resynchronize(iv, ivlen);
             aesccm16_e.SpecifyDataLengths(0, data->size(), 0);
             StringSource ss(*data, true, new AuthenticatedEncryptionFilter(aesccm16_e, new StringSink(*result)));
@@ -314,6 +326,7 @@ bool SymmCipher::ccm_encrypt(const string *data, const byte *iv, unsigned ivlen,
         }
         else if (taglen == 8)
         {
+            ensureKeyedWithIV(aesccm8_e, KEYED_CCM8_E);
             aesccm8_e.Resynchronize(iv, ivlen);
             aesccm8_e.SpecifyDataLengths(0, data->size(), 0);
             StringSource ss(*data, true, new AuthenticatedEncryptionFilter(aesccm8_e, new StringSink(*result)));
@@ -339,6 +352,7 @@ bool SymmCipher::ccm_decrypt(const string *data, const byte *iv, unsigned ivlen,
     {
         if (taglen == 16)
         {
+            ensureKeyedWithIV(aesccm16_d, KEYED_CCM16_D);
             aesccm16_d.Resynchronize(iv, ivlen);
             aesccm16_d.SpecifyDataLengths(0, data->size() - taglen, 0);
             StringSource ss(*data, true, new AuthenticatedDecryptionFilter(aesccm16_d, new StringSink(*result)));
@@ -346,6 +360,7 @@ bool SymmCipher::ccm_decrypt(const string *data, const byte *iv, unsigned ivlen,
         }
         else if (taglen == 8)
         {
+            ensureKeyedWithIV(aesccm8_d, KEYED_CCM8_D);
             aesccm8_d.Resynchronize(iv, ivlen);
             aesccm8_d.SpecifyDataLengths(0, data->size() - taglen, 0);
             StringSource ss(*data, true, new AuthenticatedDecryptionFilter(aesccm8_d, new StringSink(*result)));
@@ -370,6 +385,7 @@ bool SymmCipher::gcm_encrypt(const string *data, const byte *iv, unsigned ivlen,
 
     try
     {
+        ensureKeyedWithIV(aesgcm_e, KEYED_GCM_E);
         aesgcm_e.Resynchronize(iv, ivlen);
         StringSource ss(*data, true, new AuthenticatedEncryptionFilter(aesgcm_e, new StringSink(*result), false, taglen));
     }
@@ -413,6 +429,8 @@ bool SymmCipher::gcm_encrypt(const byte* data, const size_t datasize, const byte
     {
         if (!key || !keylen)
         {
+            ensureKeyedWithIV(aesgcm_e, KEYED_GCM_E);
+
             // resynchronizes with the provided IV
             aesgcm_e.Resynchronize(iv, static_cast<int>(ivlen));
         }
@@ -420,6 +438,7 @@ bool SymmCipher::gcm_encrypt(const byte* data, const size_t datasize, const byte
         {
             // resynchronizes with the provided Key and IV
             aesgcm_e.SetKeyWithIV(key, keylen, iv, ivlen);
+            keyedModes &= ~unsigned(KEYED_GCM_E);   // schedule no longer matches our own key
         }
 
         AuthenticatedEncryptionFilter ef (aesgcm_e, new StringSink(result), false, static_cast<int>(taglen));
@@ -458,6 +477,7 @@ bool SymmCipher::gcm_decrypt(const string *data, const byte *iv, unsigned ivlen,
 
     try
     {
+        ensureKeyedWithIV(aesgcm_d, KEYED_GCM_D);
         aesgcm_d.Resynchronize(iv, ivlen);
         StringSource ss(*data, true, new AuthenticatedDecryptionFilter(aesgcm_d, new StringSink(*result), taglen));
     }
@@ -487,6 +507,8 @@ bool SymmCipher::gcm_decrypt(const byte* data, const size_t datalen, const byte*
     {
         if (!key || !keylength)
         {
+            ensureKeyedWithIV(aesgcm_d, KEYED_GCM_D);
+
             // resynchronizes with provided IV
             aesgcm_d.Resynchronize(iv, static_cast<int>(ivlen));
         }
@@ -494,6 +516,7 @@ bool SymmCipher::gcm_decrypt(const byte* data, const size_t datalen, const byte*
         {
             // resynchronizes with the provided Key and IV
             aesgcm_d.SetKeyWithIV(key, keylength, iv, ivlen);
+            keyedModes &= ~unsigned(KEYED_GCM_D);   // schedule no longer matches our own key
         }
 
         unsigned int flags = AuthenticatedDecryptionFilter::MAC_AT_BEGIN | AuthenticatedDecryptionFilter::THROW_EXCEPTION;
@@ -657,54 +680,77 @@ void SymmCipher::ctr_crypt(byte* data, unsigned len, m_off_t pos, ctr_iv ctriv,
 {
     assert(!(pos & (KEYLENGTH - 1)));
 
-    byte ctr[BLOCKSIZE], tmp[BLOCKSIZE];
+    // keystream batching width: the counters are independent, so encrypting a
+    // run of them in one ECB pass lets the cipher pipeline the AES rounds
+    // (hardware-accelerated builds process several blocks per iteration),
+    // which the serial MAC chain below cannot
+    enum { CTRBATCH = 32 };
+
+    byte keystream[CTRBATCH * BLOCKSIZE];
 
-    MemAccess::set<int64_t>(ctr,ctriv);
-    setint64(pos / BLOCKSIZE, ctr + sizeof ctriv);
+    // the block counter occupies the high half of each counter block as a
+    // big-endian 64-bit word (see setint64), so it can be advanced with a
+    // native integer increment instead of incblock's byte-carry loop
+    uint64_t blockpos = uint64_t(pos / BLOCKSIZE);
 
     if (mac && initmac)
     {
-        memcpy(mac, ctr, sizeof ctriv);
-        memcpy(mac + sizeof ctriv, ctr, sizeof ctriv);
+        MemAccess::set<int64_t>(mac, ctriv);
+        MemAccess::set<int64_t>(mac + sizeof ctriv, ctriv);
     }
 
     while ((int)len > 0)
     {
-        if (encrypt)
+        unsigned blocks = (len + BLOCKSIZE - 1) / BLOCKSIZE;
+        if (blocks > (unsigned)CTRBATCH)
         {
-            if(mac)
-            {
-                xorblock(data, mac);
-                ecb_encrypt(mac);
-            }
+            blocks = CTRBATCH;
+        }
 
-            ecb_encrypt(ctr, tmp);
-            xorblock(tmp, data);
+        for (unsigned b = 0; b < blocks; b++)
+        {
+            byte* ks = keystream + b * BLOCKSIZE;
+            MemAccess::set<int64_t>(ks, ctriv);
+            setint64(int64_t(blockpos++), ks + sizeof ctriv);
         }
-        else
+        ecb_encrypt(keystream, NULL, blocks * BLOCKSIZE);
+
+        for (unsigned b = 0; b < blocks; b++)
         {
-            ecb_encrypt(ctr, tmp);
-            xorblock(tmp, data);
+            byte* ks = keystream + b * BLOCKSIZE;
 
-            if (mac)
+            if (encrypt)
             {
-                if (len >= (unsigned)BLOCKSIZE)
+                if(mac)
                 {
                     xorblock(data, mac);
-                }
-                else
-                {
-                    xorblock(data, mac, len);
+                    ecb_encrypt(mac);
                 }
 
-                ecb_encrypt(mac);
+                xorblock(ks, data);
             }
-        }
+            else
+            {
+                xorblock(ks, data);
 
-        len -= BLOCKSIZE;
-        data += BLOCKSIZE;
+                if (mac)
+                {
+                    if (len >= (unsigned)BLOCKSIZE)
+                    {
+                        xorblock(data, mac);
+                    }
+                    else
+                    {
+                        xorblock(data, mac, len);
+                    }
+
+                    ecb_encrypt(mac);
+                }
+            }
 
-        incblock(ctr);
+            len -= BLOCKSIZE;
+            data += BLOCKSIZE;
+        }
     }
 }
 
@@ -736,7 +782,9 @@ unsigned AsymmCipher::rawencrypt(const byte* plain, size_t plainlen, byte* buf,
 
 int AsymmCipher::encrypt(PrnGen &rng, const byte* plain, size_t plainlen, byte* buf, size_t buflen) const
 {
-    if (key[PUB_PQ].ByteCount() + 2 > buflen)
+    const size_t modulusBytes = key[PUB_PQ].ByteCount();
+
+    if (modulusBytes + 2 > buflen)
     {
         return 0;
     }
@@ -747,9 +795,9 @@ int AsymmCipher::encrypt(PrnGen &rng, const byte* plain, size_t plainlen, byte*
     }
 
     // add random padding
-    rng.genblock(buf + plainlen, key[PUB_PQ].ByteCount() - plainlen - 2);
+    rng.genblock(buf + plainlen, modulusBytes - plainlen - 2);
 
-    Integer t(buf, key[PUB_PQ].ByteCount() - 2);
+    Integer t(buf, modulusBytes - 2);
 
     rsaencrypt(key, &t);
 
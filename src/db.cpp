@@ -40,7 +40,8 @@ bool DbTable::put(uint32_t index, string* data)
 // add or update record with padding and encryption
 bool DbTable::put(uint32_t type, Cacheable* record, SymmCipher* key)
 {
-    string data;
+    string& data = mPutScratch;
+    data.clear();
 
     if (!record->serialize(&data))
     {
@@ -684,6 +684,8 @@ SyncUpload_inClient::SyncUpload_inClient(NodeHandle targetFolder, const LocalPat
     transfer = nullptr;
     tag = 0;
 
+    direction = PUT;
+
     syncThreadSafeState = move(stss);
     syncThreadSafeState->transferBegin(PUT, size);
 
@@ -745,6 +747,8 @@ SyncDownload_inClient::SyncDownload_inClient(CloudNode& n, const LocalPath& cloc
 
     setLocalname(clocalname);
 
+    direction = GET;
+
     syncThreadSafeState = move(stss);
     syncThreadSafeState->transferBegin(GET, size);
 }
@@ -571,6 +571,33 @@ bool IsContainingLocalPathOf(const string& a, const char* b, size_t bLength)
 #endif
 }
 
+namespace {
+
+// Slab pool backing LocalPath's pooled operator new/delete.  Heap-allocated
+// LocalPaths are almost exclusively the per-node shortname holders
+// (LocalNode::slocalname, FSNode::shortname), one per node on Windows.
+SlabPool& localPathSlabPool()
+{
+    static SlabPool pool(sizeof(LocalPath));
+    return pool;
+}
+
+} // anonymous namespace
+
+void* LocalPath::operator new(size_t size)
+{
+    assert(size == sizeof(LocalPath));
+    return localPathSlabPool().alloc();
+}
+
+void LocalPath::operator delete(void* p)
+{
+    if (p)
+    {
+        localPathSlabPool().release(p);
+    }
+}
+
 // TODO: may or may not be needed
 void LocalPath::removeTrailingSeparators()
 {
@@ -944,6 +971,20 @@ void LocalPath::utf8_normalize(string* filename)
 
     const char* cfilename = filename->c_str();
     size_t fnsize = filename->size();
+
+    // pure ASCII (including embedded NULs) is already NFC: skip the
+    // per-sequence utf8proc allocations for the overwhelmingly common case
+    size_t ascii = 0;
+    while (ascii < fnsize && !(static_cast<unsigned char>(cfilename[ascii]) & 0x80))
+    {
+        ascii++;
+    }
+
+    if (ascii == fnsize)
+    {
+        return;
+    }
+
     string result;
 
     for (size_t i = 0; i < fnsize; )
@@ -1540,6 +1581,17 @@ std::string LocalPath::platformEncoded() const
 #endif
 }
 
+void LocalPath::serializePlatformEncoded(CacheableWriter& w) const
+{
+#ifdef WIN32
+    // conversion (and prefix stripping) needed, go via the copying form
+    w.serializestring(platformEncoded());
+#else
+    assert(invariant());
+    w.serializestring(localpath);
+#endif
+}
+
 
 void LocalPath::appendWithSeparator(const LocalPath& additionalPath, bool separatorAlways)
 {
@@ -2408,7 +2460,7 @@ ScanService::~ScanService()
     }
 }
 
-auto ScanService::queueScan(LocalPath targetPath, handle expectedFsid, bool followSymlinks, map<LocalPath, FSNode>&& priorScanChildren, shared_ptr<Waiter> waiter) -> RequestPtr
+auto ScanService::queueScan(LocalPath targetPath, handle expectedFsid, bool followSymlinks, fsnode_map&& priorScanChildren, shared_ptr<Waiter> waiter) -> RequestPtr
 {
     // Create a request to represent the scan.
     auto request = std::make_shared<ScanRequest>(std::move(waiter), followSymlinks, targetPath, expectedFsid, std::move(priorScanChildren));
@@ -2423,7 +2475,7 @@ ScanService::ScanRequest::ScanRequest(shared_ptr<Waiter> waiter,
     bool followSymLinks,
     LocalPath targetPath,
     handle expectedFsid,
-    map<LocalPath, FSNode>&& priorScanChildren)
+    fsnode_map&& priorScanChildren)
     : mWaiter(waiter)
     , mScanResult(SCAN_INPROGRESS)
     , mFollowSymLinks(followSymLinks)
@@ -489,7 +489,7 @@ HttpReq::~HttpReq()
         httpio->cancel(this);
     }
 
-    delete[] buf;
+    http_buf_t::freebuf(buf);
 }
 
 void HttpReq::init()
@@ -505,6 +505,7 @@ void HttpReq::init()
     outpos = 0;
     in.clear();
     contenttype.clear();
+    contentTypeIsHtml = false;
     mRedirectURL.clear();
 }
 
@@ -528,6 +529,7 @@ void HttpReq::setreq(const char* u, contenttype_t t)
     if (u)
     {
         posturl = u;
+        isHttp = !posturl.compare(0, 5, "http:");
     }
 
     type = t;
@@ -560,6 +562,97 @@ void HttpReq::put(void* data, unsigned len, bool purge)
 }
 
 
+namespace {
+
+// Recycled backing blocks for download chunk buffers, keyed by allocation
+// size (a transfer uses only a handful of distinct chunk sizes).  The size
+// is stashed in a small header ahead of the returned pointer so a block
+// finds its bucket again on release.  Blocks are handed out uninitialised -
+// never zero-filled - since the network layer overwrites every byte before
+// anything reads them.  Cached bytes are capped so an idle
+// client does not sit on transfer-sized buffers.  (The pool population is
+// dynamic, so these blocks are not candidates for pre-registration with a
+// kernel I/O interface; that would require a fixed arena sized up front.)
+class ChunkBufferPool
+{
+    enum { HEADER = 16 };
+    enum { MAX_CACHED_BYTES = 64 * 1024 * 1024 };
+
+    std::mutex m;
+    map<size_t, vector<byte*>> freeBlocks;
+    size_t cachedBytes = 0;
+
+public:
+    byte* alloc(size_t n)
+    {
+        {
+            std::lock_guard<std::mutex> g(m);
+            map<size_t, vector<byte*>>::iterator it = freeBlocks.find(n);
+            if (it != freeBlocks.end() && !it->second.empty())
+            {
+                byte* p = it->second.back();
+                it->second.pop_back();
+                cachedBytes -= n;
+                return p;
+            }
+        }
+
+        byte* raw = new byte[HEADER + n];
+        memcpy(raw, &n, sizeof n);
+        return raw + HEADER;
+    }
+
+    void release(byte* p)
+    {
+        size_t n;
+        memcpy(&n, p - HEADER, sizeof n);
+
+        {
+            std::lock_guard<std::mutex> g(m);
+            if (cachedBytes + n <= MAX_CACHED_BYTES)
+            {
+                freeBlocks[n].push_back(p);
+                cachedBytes += n;
+                return;
+            }
+        }
+
+        delete[] (p - HEADER);
+    }
+
+    ~ChunkBufferPool()
+    {
+        for (map<size_t, vector<byte*>>::iterator it = freeBlocks.begin(); it != freeBlocks.end(); ++it)
+        {
+            for (size_t i = 0; i < it->second.size(); ++i)
+            {
+                delete[] (it->second[i] - HEADER);
+            }
+        }
+    }
+};
+
+ChunkBufferPool& chunkBufferPool()
+{
+    static ChunkBufferPool pool;
+    return pool;
+}
+
+} // anonymous namespace
+
+byte* HttpReq::http_buf_t::allocbuf(size_t n)
+{
+    return chunkBufferPool().alloc(n);
+}
+
+void HttpReq::http_buf_t::freebuf(byte* p)
+{
+    if (p)
+    {
+        chunkBufferPool().release(p);
+    }
+}
+
 HttpReq::http_buf_t::http_buf_t(byte* b, size_t s, size_t e)
     : start(s), end(e), buf(b)
 {
@@ -567,7 +660,7 @@ HttpReq::http_buf_t::http_buf_t(byte* b, size_t s, size_t e)
 
 HttpReq::http_buf_t::~http_buf_t()
 {
-    delete[] buf;
+    freebuf(buf);
 }
 
 void HttpReq::http_buf_t::swap(http_buf_t& other)
@@ -600,6 +693,7 @@ struct HttpReq::http_buf_t* HttpReq::release_buf()
     buf = NULL;
     inpurge = 0;
     buflen = 0;
+    bufcap = 0;
     bufpos = 0;
     outpos = 0;
     notifiedbufpos = 0;
@@ -711,21 +805,27 @@ void HttpReqDL::prepare(const char* tempurl, SymmCipher* /*key*/,
     size = (unsigned)(npos - pos);
     buffer_released = false;
 
-    if (!buf || buflen != size)
+    // reuse the existing buffer when its capacity suffices (chunk sizes only
+    // vary at the ends of a transfer), so retried and resized requests do not
+    // cycle multi-megabyte allocations through the allocator
+    m_off_t needed = (size + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE;
+    if (!buf || bufcap < needed)
     {
         // (re)allocate buffer
         if (buf)
         {
-            delete[] buf;
+            http_buf_t::freebuf(buf);
             buf = NULL;
+            bufcap = 0;
         }
 
         if (size)
         {
-            buf = new byte[(size + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE];
+            buf = http_buf_t::allocbuf(size_t(needed));
+            bufcap = needed;
         }
-        buflen = size;
     }
+    buflen = size;
 }
 
 
@@ -1509,19 +1509,13 @@ std::shared_ptr<Node> MegaClient::childnodebyname(const Node* p, const char* nam
 
     LocalPath::utf8_normalize(&nname);
 
-    std::shared_ptr<Node> node;
-
-    if (!skipfolders)
-    {
-        node = mNodeManager.childNodeByNameType(p, nname, FOLDERNODE);
-    }
-
-    if (!node)
+    if (skipfolders)
     {
-        node = mNodeManager.childNodeByNameType(p, nname, FILENODE);
+        return mNodeManager.childNodeByNameType(p, nname, FILENODE);
     }
 
-    return node;
+    // single pass over the children instead of a folder scan followed by a file scan
+    return mNodeManager.childNodeByNameFolderFirst(p, nname);
 }
 
 // returns a matching child node by UTF-8 name (does not resolve name clashes)
@@ -1726,6 +1720,8 @@ MegaClient::MegaClient(MegaApp* a, shared_ptr<Waiter> w, HttpIO* h, DbAccess* d,
     orderdownloadedchunks = true;
 #endif
 
+    dropwrittenchunkcache = false;
+
     fetchingnodes = false;
     fetchnodestag = 0;
 
@@ -5904,7 +5900,7 @@ void MegaClient::CacheableStatusMap::loadCachedStatus(CacheableStatus::Type type
 #ifndef NDEBUG
     auto it =
 #endif
-    insert(pair<int64_t, CacheableStatus>(type, CacheableStatus(type, value)));
+    emplace(type, CacheableStatus(type, value));
     assert(it.second);
 
     LOG_verbose << "Loaded status from cache: " << CacheableStatus::typeToStr(type) << " = " << value;
@@ -9049,6 +9045,9 @@ error MegaClient::pw_key(const char* utf8pw, byte* key) const
 
 SymmCipher *MegaClient::getRecycledTemporaryTransferCipher(const byte *key, int type)
 {
+    // setkey itself short-circuits when the same key is already loaded, so the
+    // cipher keeps its cached schedules across the repeated lookups the
+    // transfer code makes per doio tick
     tmptransfercipher.setkey(key, type);
     return &tmptransfercipher;
 }
@@ -9374,7 +9373,8 @@ int MegaClient::readnode(JSON* j, int notify, putsource_t source, vector<NewNode
                     sts = ts;
                 }
 
-                n = std::make_shared<Node>(*this, NodeHandle().set6byte(h), NodeHandle().set6byte(ph), t, s, u, fas.c_str(), ts);
+                // not make_shared: route the Node allocation through the slab pool
+                n = shared_ptr<Node>(new Node(*this, NodeHandle().set6byte(h), NodeHandle().set6byte(ph), t, s, u, fas.c_str(), ts));
                 n->changed.newnode = true;
                 n->changed.modifiedByThisClient = modifiedByThisClient;
 
@@ -13657,7 +13657,7 @@ bool MegaClient::fetchsc(DbTable* sctable)
                     // When all nodes are loaded we force a commit
                    isDbUpgraded = true;
 
-                   bool rootNode = n->type == ROOTNODE || n->type == RUBBISHNODE || n->type == VAULTNODE;
+                   bool rootNode = isRootNodeType(n->type);
                    if (rootNode)
                    {
                        mNodeManager.setrootnode(n);
@@ -16721,7 +16721,7 @@ bool MegaClient::startxfer(direction_t d, File* f, TransferDbCommitter& committe
             t->lastaccesstime = m_time();
             t->tag = tag;
             f->tag = tag;
-            t->transfers_it = multi_transfers[d].insert(pair<FileFingerprint*, Transfer*>((FileFingerprint*)t, t));
+            t->transfers_it = multi_transfers[d].emplace((FileFingerprint*)t, t);
 
             f->file_it = t->files.insert(t->files.end(), f);
             f->transfer = t;
@@ -37,6 +37,52 @@ namespace mega {
 
 const vector<string> Node::attributesToCopyIntoPreviousVersions{ "fav", "lbl", "sen" };
 
+namespace {
+
+// Slab pools backing the pooled operator new/delete of Node and its
+// per-node companion objects.
+SlabPool& nodeSlabPool()
+{
+    static SlabPool pool(sizeof(Node));
+    return pool;
+}
+
+SlabPool& publicLinkSlabPool()
+{
+    static SlabPool pool(sizeof(PublicLink));
+    return pool;
+}
+
+} // anonymous namespace
+
+void* Node::operator new(size_t size)
+{
+    assert(size == sizeof(Node));
+    return nodeSlabPool().alloc();
+}
+
+void Node::operator delete(void* p)
+{
+    if (p)
+    {
+        nodeSlabPool().release(p);
+    }
+}
+
+void* PublicLink::operator new(size_t size)
+{
+    assert(size == sizeof(PublicLink));
+    return publicLinkSlabPool().alloc();
+}
+
+void PublicLink::operator delete(void* p)
+{
+    if (p)
+    {
+        publicLinkSlabPool().release(p);
+    }
+}
+
 Node::Node(MegaClient& cclient, NodeHandle h, NodeHandle ph,
            nodetype_t t, m_off_t s, handle u, const char* fa, m_time_t ts)
     : client(&cclient)
@@ -53,7 +99,10 @@ Node::Node(MegaClient& cclient, NodeHandle h, NodeHandle ph,
     size = s;
     owner = u;
 
-    JSON::copystring(&fileattrstring, fa);
+    if (fa && *fa)  // most nodes carry no file attributes; skip the strchr scan
+    {
+        JSON::copystring(&fileattrstring, fa);
+    }
 
     ctime = ts;
 
@@ -61,8 +110,6 @@ Node::Node(MegaClient& cclient, NodeHandle h, NodeHandle ph,
 
     memset(&changed, 0, sizeof changed);
 
-    mFingerPrintPosition = client->mNodeManager.invalidFingerprintPos();
-
     if (type == FILENODE)
     {
         mCounter.files = 1;
@@ -89,8 +136,13 @@ Node::~Node()
         // the logout.
     }
 
-    // abort pending direct reads
-    client->preadabort(this);
+    // abort pending direct reads; almost no nodes have one, so test the map
+    // before paying a handle encode plus lookup per destroyed node -- this is
+    // the dominant cost when tearing down the whole tree at logout
+    if (!client->hdrns.empty())
+    {
+        client->preadabort(this);
+    }
 }
 
 int Node::getShareType() const
@@ -527,7 +579,7 @@ void Node::setkeyfromjson(const char* k)
 {
     string tmp;
     JSON::copystring(&tmp, k);
-    setKey(tmp);
+    setKey(std::move(tmp));
 }
 
 // update node key (already decrypted) and attempt to decrypt attributes
@@ -536,17 +588,18 @@ void Node::setkey(const byte* newkey)
     if (newkey)
     {
         string tmp(reinterpret_cast<const char*>(newkey), (type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH);
-        setKey(tmp);
+        setKey(std::move(tmp));
     }
 
     setattr();
 }
 
 // set the node key (encrypted or decrypted)
-void Node::setKey(const string& key)
+void Node::setKey(string key)
 {
     if (keyApplied()) --client->mAppliedKeyNodeCount;
-    nodekeydata = key;
+    nodekeydata = std::move(key);
+    updateKeyApplied();
     if (keyApplied()) ++client->mAppliedKeyNodeCount;
     assert(client->mAppliedKeyNodeCount >= 0);
 }
@@ -568,13 +621,31 @@ std::shared_ptr<Node> Node::unserialize(MegaClient& client, const std::string *d
     char isExported = '\0';
     char hasLinkCreationTs = '\0';
 
-    if (ptr + sizeof s + 2 * MegaClient::NODEHANDLE + MegaClient::USERHANDLE + 2 * sizeof ts + sizeof ll > end)
+#pragma pack(push,1)
+    // fixed-size prefix of a serialized node, copied out of the cache
+    // buffer in one go instead of with a field-by-field load chain
+    struct NodeHeader
+    {
+        m_off_t s;
+        char h[MegaClient::NODEHANDLE];
+        char ph[MegaClient::NODEHANDLE];
+        char u[MegaClient::USERHANDLE];
+        // FIME: use m_time_t / Serialize64 instead
+        time_t reserved;    // always serialized as zero
+        time_t ts;
+    };
+#pragma pack(pop)
+
+    if (ptr + sizeof(NodeHeader) + sizeof ll > end)
     {
         return NULL;
     }
 
-    s = MemAccess::get<m_off_t>(ptr);
-    ptr += sizeof s;
+    NodeHeader header;
+    memcpy(&header, ptr, sizeof header);
+    ptr += sizeof header;
+
+    s = header.s;
 
     if (s < 0 && s >= -RUBBISHNODE)
     {
@@ -586,12 +657,10 @@ std::shared_ptr<Node> Node::unserialize(MegaClient& client, const std::string *d
     }
 
     h = 0;
-    memcpy((char*)&h, ptr, MegaClient::NODEHANDLE);
-    ptr += MegaClient::NODEHANDLE;
+    memcpy((char*)&h, header.h, MegaClient::NODEHANDLE);
 
     ph = 0;
-    memcpy((char*)&ph, ptr, MegaClient::NODEHANDLE);
-    ptr += MegaClient::NODEHANDLE;
+    memcpy((char*)&ph, header.ph, MegaClient::NODEHANDLE);
 
     if (!ph)
     {
@@ -599,14 +668,9 @@ std::shared_ptr<Node> Node::unserialize(MegaClient& client, const std::string *d
     }
 
     u = 0;
-    memcpy((char*)&u, ptr, MegaClient::USERHANDLE);
-    ptr += MegaClient::USERHANDLE;
+    memcpy((char*)&u, header.u, MegaClient::USERHANDLE);
 
-    // FIME: use m_time_t / Serialize64 instead
-    ptr += sizeof(time_t);
-
-    ts = (uint32_t)MemAccess::get<time_t>(ptr);
-    ptr += sizeof(time_t);
+    ts = (uint32_t)header.ts;
 
     if ((t == FILENODE) || (t == FOLDERNODE))
     {
@@ -700,7 +764,8 @@ std::shared_ptr<Node> Node::unserialize(MegaClient& client, const std::string *d
         skey = NULL;
     }
 
-    shared_ptr<Node> n = std::make_shared<Node>(client, NodeHandle().set6byte(h), NodeHandle().set6byte(ph), t, s, u, fa, ts);
+    // not make_shared: route the Node allocation through the slab pool
+    shared_ptr<Node> n(new Node(client, NodeHandle().set6byte(h), NodeHandle().set6byte(ph), t, s, u, fa, ts));
 
     // read inshare, outshares, or pending shares
     while (numshares)   // inshares: -1, outshare/s: num_shares
@@ -822,7 +887,7 @@ std::shared_ptr<Node> Node::unserialize(MegaClient& client, const std::string *d
         ptr += length;
     }
 
-    n->setKey(nodekey); // it can be decrypted or encrypted
+    n->setKey(std::move(nodekey)); // it can be decrypted or encrypted
 
     if (!encrypted)
     {
@@ -871,6 +936,15 @@ bool Node::serialize(string* d) const
     short numshares;
     m_off_t s;
 
+    // preallocate: the append sequence below otherwise regrows the buffer
+    // several times per node while saving large trees to the db
+    size_t shareCount = (inshare ? 1 : 0)
+                      + (outshares ? outshares->size() : 0)
+                      + (pendingshares ? pendingshares->size() : 0);
+    d->reserve(d->size() + 128 + nodekeydata.size() + fileattrstring.size()
+               + attrs.storagesize(11) + shareCount * 64
+               + (attrstring ? attrstring->size() + 8 : 0));
+
     s = type ? -type : size;
 
     d->append((char*)&s, sizeof s);
@@ -1042,14 +1116,24 @@ byte* Node::decryptattr(SymmCipher* key, const char* attrstring, size_t attrstrl
 
         l = Base64::atob(attrstring, buf.get(), l);
 
-        if (!(l & (SymmCipher::BLOCKSIZE - 1)))
+        if (l && !(l & (SymmCipher::BLOCKSIZE - 1)))
         {
             if (!key->cbc_decrypt(buf.get(), l))
             {
                 return nullptr;
             }
 
-            if (!memcmp(buf.get(), "MEGA{\"", 6))
+            // the plaintext must open with the magic "MEGA{\"": check it with
+            // one masked 64-bit compare instead of a memcmp call (l is a
+            // nonzero multiple of BLOCKSIZE, so 8 bytes are always available)
+            static const unsigned char magicref[8] = { 'M', 'E', 'G', 'A', '{', '"', 0, 0 };
+            static const unsigned char magicmask[8] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0, 0 };
+            uint64_t x, ref, mask;
+            memcpy(&x, buf.get(), sizeof x);
+            memcpy(&ref, magicref, sizeof ref);
+            memcpy(&mask, magicmask, sizeof mask);
+
+            if ((x & mask) == ref)
             {
                 return buf.release();
             }
@@ -1283,7 +1367,7 @@ void Node::setfingerprint()
             mtime = ctime;
         }
 
-        mFingerPrintPosition = client->mNodeManager.insertFingerprint(this);
+        mFingerPrintInContainer = client->mNodeManager.insertFingerprint(this);
     }
 }
 
@@ -1335,40 +1419,54 @@ const char* Node::displayname() const
 string Node::displaypath() const
 {
     // factored from nearly identical functions in megapi_impl and megacli
-    string path;
+    // Components are collected walking up the tree and joined in one pass:
+    // building the string with insert(0, ...) is quadratic in path depth.
+    vector<const char*> pieces;
+
+    auto join = [&pieces]()
+    {
+        size_t len = 0;
+        for (const char* piece : pieces)
+        {
+            len += strlen(piece);
+        }
+
+        string path;
+        path.reserve(len);
+        for (size_t i = pieces.size(); i--; )
+        {
+            path.append(pieces[i]);
+        }
+        return path;
+    };
+
     const Node* n = this;
     for (; n; n = n->parent.get())
     {
         switch (n->type)
         {
         case FOLDERNODE:
-            path.insert(0, n->displayname());
+            pieces.push_back(n->displayname());
 
             if (n->inshare)
             {
-                path.insert(0, ":");
-                if (n->inshare->user)
-                {
-                    path.insert(0, n->inshare->user->email);
-                }
-                else
-                {
-                    path.insert(0, "UNKNOWN");
-                }
-                return path;
+                pieces.push_back(":");
+                pieces.push_back(n->inshare->user ? n->inshare->user->email.c_str()
+                                                  : "UNKNOWN");
+                return join();
             }
             break;
 
         case VAULTNODE:
-            path.insert(0, "//in");
-            return path;
+            pieces.push_back("//in");
+            return join();
 
         case ROOTNODE:
-            return path.empty() ? "/" : path;
+            return pieces.empty() ? "/" : join();
 
         case RUBBISHNODE:
-            path.insert(0, "//bin");
-            return path;
+            pieces.push_back("//bin");
+            return join();
 
         case TYPE_DONOTSYNC:
         case TYPE_NESTED_MOUNT:
@@ -1376,11 +1474,11 @@ string Node::displaypath() const
         case TYPE_SYMLINK:
         case TYPE_UNKNOWN:
         case FILENODE:
-            path.insert(0, n->displayname());
+            pieces.push_back(n->displayname());
         }
-        path.insert(0, "/");
+        pieces.push_back("/");
     }
-    return path;
+    return join();
 }
 
 bool Node::isIncludedForMimetype(MimeType_t mimetype, bool checkPreview) const
@@ -1430,10 +1528,36 @@ int Node::hasfileattribute(fatype t) const
 
 int Node::hasfileattribute(const string *fileattrstring, fatype t)
 {
-    char buf[24];
+    // scan for ":<t>*" directly rather than formatting the pattern with
+    // snprintf and delegating to string::find - this runs for every
+    // attribute query on every node, so avoid the libc format machinery
+    const char* begin = fileattrstring->data();
+    const char* end = begin + fileattrstring->size();
+    const char* p = begin;
+
+    while ((p = static_cast<const char*>(memchr(p, ':', static_cast<size_t>(end - p)))))
+    {
+        const char* q = p + 1;
+        if (q < end && *q >= '0' && *q <= '9')
+        {
+            unsigned v = 0;
+            do
+            {
+                v = v * 10 + static_cast<unsigned>(*q++ - '0');
+            } while (q < end && *q >= '0' && *q <= '9');
+
+            if (v == static_cast<unsigned>(t) && q < end && *q == '*')
+            {
+                // 1-based position of the separator, 0 meaning absent,
+                // matching the previous find() + 1 contract
+                return static_cast<int>(p - begin) + 1;
+            }
+        }
 
-    snprintf(buf, sizeof(buf), ":%u*", t);
-    return static_cast<int>(fileattrstring->find(buf) + 1);
+        p++;
+    }
+
+    return 0;
 }
 
 // attempt to apply node key - sets nodekey to a raw key if successful
@@ -1451,20 +1575,29 @@ bool Node::applykey()
     }
 
     int l = -1;
-    size_t t = 0;
+    size_t t;
+    size_t segstart = 0;
     handle h;
     const char* k = NULL;
     SymmCipher* sc = &client->key;
     handle me = client->loggedIntoFolder() ? client->mNodeManager.getRootNodeFiles().as8byte() : client->me;
 
-    while ((t = nodekeydata.find_first_of(':', t)) != string::npos)
+    // walk the handle:key/handle:key/... list in one forward pass, tracking
+    // where the current handle segment starts rather than re-scanning
+    // backwards with find_last_of for every candidate subkey
+    while ((t = nodekeydata.find_first_of(':', segstart)) != string::npos)
     {
         // compound key: locate suitable subkey (always symmetric)
         h = 0;
 
-        l = Base64::atob(nodekeydata.c_str() + (nodekeydata.find_last_of('/', t) + 1), (byte*)&h, sizeof h);
+        l = Base64::atob(nodekeydata.c_str() + segstart, (byte*)&h, sizeof h);
         t++;
 
+        // next handle segment (if this one is rejected) begins after the '/'
+        // that terminates the key we are about to skip
+        segstart = nodekeydata.find_first_of('/', t);
+        segstart = segstart == string::npos ? nodekeydata.size() : segstart + 1;
+
         if (l == MegaClient::USERHANDLE)
         {
             // this is a user handle - reject if it's not me
@@ -1538,9 +1671,10 @@ bool Node::applykey()
 
     if (client->decryptkey(k, key, keylength, sc, 0, nodehandle))
     {
-        std::string undecryptedKey = nodekeydata;
+        std::string undecryptedKey = std::move(nodekeydata);
         client->mAppliedKeyNodeCount++;
         nodekeydata.assign((const char*)key, keylength);
+        updateKeyApplied();
         setattr();
         if (attrstring)
         {
@@ -1550,7 +1684,8 @@ bool Node::applykey()
                 // Restoring the undecrypted node key because an updated
                 // share key can be received later.
                 client->mAppliedKeyNodeCount--;
-                nodekeydata = undecryptedKey;
+                nodekeydata = std::move(undecryptedKey);
+                updateKeyApplied();
             }
             LOG_warn << "Failed to decrypt attributes for node: " << toNodeHandle(nodehandle);
         }
@@ -1646,7 +1781,7 @@ bool Node::setparent(std::shared_ptr<Node> p, bool updateNodeCounters)
 
     if (updateNodeCounters)
     {
-        std::shared_ptr<Node> node = this->mNodePosition->second.getNodeInRam();
+        std::shared_ptr<Node> node = this->mNodePosition->getNodeInRam();
         assert(node);
         client->mNodeManager.updateCounter(node, oldparent);
     }
@@ -1667,7 +1802,7 @@ const Node* Node::firstancestor() const
 
 std::shared_ptr<Node> Node::latestFileVersion() const
 {
-    std::shared_ptr<Node> n = this->mNodePosition->second.getNodeInRam();
+    std::shared_ptr<Node> n = this->mNodePosition->getNodeInRam();
     if (type == FILENODE)
     {
         while (n->parent && n->parent->type == FILENODE)
@@ -1768,6 +1903,54 @@ bool PublicLink::isExpired()
 }
 
 #ifdef ENABLE_SYNC
+
+namespace {
+
+// LocalNode gets the same slab treatment as Node: a large sync allocates and
+// frees these by the million, and co-locating siblings in slab pages helps
+// the recursive scan/sync passes as much as the cheaper allocation does.
+SlabPool& localNodeSlabPool()
+{
+    static SlabPool pool(sizeof(LocalNode));
+    return pool;
+}
+
+SlabPool& rareFieldsSlabPool()
+{
+    static SlabPool pool(sizeof(LocalNode::RareFields));
+    return pool;
+}
+
+} // anonymous namespace
+
+void* LocalNode::RareFields::operator new(size_t size)
+{
+    assert(size == sizeof(LocalNode::RareFields));
+    return rareFieldsSlabPool().alloc();
+}
+
+void LocalNode::RareFields::operator delete(void* p)
+{
+    if (p)
+    {
+        rareFieldsSlabPool().release(p);
+    }
+}
+
+void* LocalNode::operator new(size_t size)
+{
+    assert(size == sizeof(LocalNode));
+    return localNodeSlabPool().alloc();
+}
+
+void LocalNode::operator delete(void* p)
+{
+    if (p)
+    {
+        localNodeSlabPool().release(p);
+    }
+}
+
 // set, change or remove LocalNode's parent and localname/slocalname.
 // newlocalpath must be a leaf name and must not point to an empty string (unless newparent == NULL).
 // no shortname allowed as the last path component.
@@ -1904,6 +2087,9 @@ void LocalNode::moveContentTo(LocalNode* ln, LocalPath& fullPath, bool setScanAg
         c->setnameparent(ln, fullPath.leafName(), sync->syncs.fsaccess->fsShortname(fullPath));
 
         // if moving between syncs, removal from old sync db is already done
+        // statecacheadd only queues into insertq; the whole batch is written
+        // later in cachenodes() under a single DBTableTransactionCommitter,
+        // so this loop does not cause one DB transaction per child
         ln->sync->statecacheadd(c);
 
         if (setScanAgain)
@@ -1917,6 +2103,8 @@ void LocalNode::moveContentTo(LocalNode* ln, LocalPath& fullPath, bool setScanAg
     LocalTreeProcUpdateTransfers tput;
     tput.proc(*sync->syncs.fsaccess, ln);
 
+    // the filter chain itself lives in RareFields and stays with the target's
+    // own ignore file; only this one pending-load bit needs to carry over
     ln->mWaitingForIgnoreFileLoad = mWaitingForIgnoreFileLoad;
 
     // Make sure our exclusion state is recomputed.
@@ -1953,10 +2141,6 @@ LocalNode::LocalNode(Sync* csync)
 , localFSCannotStoreThisName(0)
 , mIsIgnoreFile(false)
 {
-    fsid_lastSynced_it = sync->syncs.localnodeBySyncedFsid.end();
-    fsid_asScanned_it = sync->syncs.localnodeByScannedFsid.end();
-    syncedCloudNodeHandle_it = sync->syncs.localnodeByNodeHandle.end();
-
     sync->syncs.totalLocalNodes++;
 }
 
@@ -2065,6 +2249,7 @@ void LocalNode::trimRareFields()
 
         if (!rareFields->scanBlocked &&
             !rareFields->scanRequest &&
+            !rareFields->lastFolderScan &&
             rareFields->movePendingFrom.expired() &&
             !rareFields->movePendingTo &&
             !rareFields->moveFromHere &&
@@ -2100,12 +2285,15 @@ void LocalNode::setScanAgain(bool doParent, bool doHere, bool doBelow, dstime de
     auto state = TreeState((doHere?1u:0u) << 1 | (doBelow?1u:0u));
 
     if (state >= TREE_ACTION_HERE && delayds > 0)
-        scanDelayUntil = std::max<dstime>(scanDelayUntil,  Waiter::ds + delayds);
+        scanDelayUntil = std::max<dstime>(scanDelayUntil, Waiter::ds + delayds);
 
     scanAgain = std::max<TreeState>(scanAgain, state);
-    for (auto p = parent; p != NULL; p = p->parent)
+
+    // an already-flagged ancestor implies the rest of the chain was raised by
+    // a previous call, so the climb can stop there instead of walking to root
+    for (auto p = parent; p != NULL && p->scanAgain < TREE_DESCENDANT_FLAGGED; p = p->parent)
     {
-        p->scanAgain = std::max<TreeState>(p->scanAgain, TREE_DESCENDANT_FLAGGED);
+        p->scanAgain = TREE_DESCENDANT_FLAGGED;
     }
 
     // for scanning, we only need to set the parent once
@@ -2123,9 +2311,9 @@ void LocalNode::setCheckMovesAgain(bool doParent, bool doHere, bool doBelow)
     auto state = TreeState((doHere?1u:0u) << 1 | (doBelow?1u:0u));
 
     checkMovesAgain = std::max<TreeState>(checkMovesAgain, state);
-    for (auto p = parent; p != NULL; p = p->parent)
+    for (auto p = parent; p != NULL && p->checkMovesAgain < TREE_DESCENDANT_FLAGGED; p = p->parent)
     {
-        p->checkMovesAgain = std::max<TreeState>(p->checkMovesAgain, TREE_DESCENDANT_FLAGGED);
+        p->checkMovesAgain = TREE_DESCENDANT_FLAGGED;
     }
 
     parentSetCheckMovesAgain = parentSetCheckMovesAgain || doParent;
@@ -2145,6 +2333,11 @@ void LocalNode::setSyncAgain(bool doParent, bool doHere, bool doBelow)
             p->syncAgain = std::max<TreeState>(p->syncAgain, TREE_ACTION_HERE);
             doParent = false;
         }
+        else if (p->syncAgain >= TREE_DESCENDANT_FLAGGED)
+        {
+            // ancestors above are already at least TREE_DESCENDANT_FLAGGED
+            break;
+        }
 
         p->syncAgain = std::max<TreeState>(p->syncAgain, TREE_DESCENDANT_FLAGGED);
     }
@@ -2158,9 +2351,9 @@ void LocalNode::setContainsConflicts(bool doParent, bool doHere, bool doBelow)
     auto state = TreeState((doHere?1u:0u) << 1 | (doBelow?1u:0u));
 
     conflicts = std::max<TreeState>(conflicts, state);
-    for (auto p = parent; p != NULL; p = p->parent)
+    for (auto p = parent; p != NULL && p->conflicts < TREE_DESCENDANT_FLAGGED; p = p->parent)
     {
-        p->conflicts = std::max<TreeState>(p->conflicts, TREE_DESCENDANT_FLAGGED);
+        p->conflicts = TREE_DESCENDANT_FLAGGED;
     }
 
     parentSetContainsConflicts = parentSetContainsConflicts || doParent;
@@ -2250,6 +2443,7 @@ bool LocalNode::scanRequired() const
 
 void LocalNode::clearRegeneratableFolderScan(SyncPath& fullPath, vector<SyncRow>& childRows)
 {
+    const auto& lastFolderScan = rareRO().lastFolderScan;
     if (lastFolderScan &&
         lastFolderScan->size() == children.size())
     {
@@ -2274,8 +2468,7 @@ void LocalNode::clearRegeneratableFolderScan(SyncPath& fullPath, vector<SyncRow>
                 }
 
                 ++nChecked;
-                auto generated = row.syncNode->getScannedFSDetails();
-                if (!generated.equivalentTo(*row.fsNode)) return;
+                if (!row.syncNode->scannedFSDetailsEquivalentTo(*row.fsNode)) return;
             }
         }
 
@@ -2283,7 +2476,8 @@ void LocalNode::clearRegeneratableFolderScan(SyncPath& fullPath, vector<SyncRow>
         {
             // LocalNodes are now consistent with the last scan.
             LOG_debug << sync->syncname << "Clearing regeneratable folder scan records (" << lastFolderScan->size() << ") at " << fullPath.localPath;
-            lastFolderScan.reset();
+            rare().lastFolderScan.reset();
+            trimRareFields();
         }
     }
 }
@@ -2301,6 +2495,16 @@ bool LocalNode::syncRequired() const
 
 void LocalNode::propagateAnySubtreeFlags()
 {
+    // without a TREE_ACTION_SUBTREE flag here there is nothing to push down
+    // (propagateSubtreeFlag leaves the child flags untouched), so don't drag
+    // every child's flag word through the cache for nothing
+    if (scanAgain != TREE_ACTION_SUBTREE &&
+        checkMovesAgain != TREE_ACTION_SUBTREE &&
+        syncAgain != TREE_ACTION_SUBTREE)
+    {
+        return;
+    }
+
     for (auto& child : children)
     {
         if (child.second->type != FILENODE)
@@ -2363,13 +2567,15 @@ bool LocalNode::processBackgroundFolderScan(SyncRow& row, SyncPath& fullPath)
             scanInProgress = true;
 
             // If enough details of the scan are the same, we can reuse fingerprints instead of recalculating
-            map<LocalPath, FSNode> priorScanChildren;
+            fsnode_map priorScanChildren;
+            priorScanChildren.reserve(children.size() +
+                (rareRO().lastFolderScan ? rareRO().lastFolderScan->size() : 0));
 
-            if (lastFolderScan)
+            if (rareRO().lastFolderScan)
             {
                 // use the same fingerprint shortcut data as the last time we scanned,
                 // if we still have it (including fingerprint isvalid flag)
-                for (auto& f : *lastFolderScan)
+                for (auto& f : *rareRO().lastFolderScan)
                 {
                     if (f.type == FILENODE && f.fingerprint.isvalid)
                     {
@@ -2452,13 +2658,14 @@ bool LocalNode::processBackgroundFolderScan(SyncRow& row, SyncPath& fullPath)
             scanObsolete = false;
 
             // Scan results are out of date but may still be useful.
-            lastFolderScan.reset(new vector<FSNode>(ourScanRequest->resultNodes()));
+            rare().lastFolderScan.reset(new vector<FSNode>(ourScanRequest->resultNodes()));
 
             // Mark this directory as requiring another scan.
             setScanAgain(false, true, false, 10);
         }
         else if (SCAN_SUCCESS == ourScanRequest->completionResult())
         {
+            auto& lastFolderScan = rare().lastFolderScan;
             lastFolderScan.reset(new vector<FSNode>(ourScanRequest->resultNodes()));
 
             for (auto& i : *lastFolderScan)
@@ -2595,7 +2802,9 @@ treestate_t LocalNode::checkTreestate(bool notifyChangeToApp)
 {
     // notify file explorer if the sync state overlay icon should change
 
-    treestate_t ts = TREESTATE_NONE;
+    // derived from this node's own subtree flags only - no child iteration,
+    // so calling this for every row of a wide directory stays linear overall
+    treestate_t ts;
 
     if (ES_INCLUDED != exclusionState())
     {
@@ -2622,23 +2831,48 @@ treestate_t LocalNode::checkTreestate(bool notifyChangeToApp)
         ts = TREESTATE_PENDING;
     }
 
+    // no recursion and no parent climb here: the report below already
+    // returns early when the state is unchanged, and ancestors recompute
+    // their own state from their flags when their rows are visited
     recursiveSetAndReportTreestate(ts, false, notifyChangeToApp);
 
     return ts;
 }
 
 
+namespace {
+
+// Erase this node's entry for the given key.  The hashed multimaps
+// invalidate iterators on rehash, so membership is tracked with a flag and
+// the entry is found again here; keys are near-unique so the scan is short.
+template <class MultiMap, class Key>
+void eraseAssociation(MultiMap& m, const Key& key, const LocalNode* n)
+{
+    auto range = m.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == n)
+        {
+            m.erase(it);
+            return;
+        }
+    }
+    assert(false);  // flag said we were in the map
+}
+
+} // anonymous namespace
+
 // set fsid - assume that an existing assignment of the same fsid is no longer current and revoke
 void LocalNode::setSyncedFsid(handle newfsid, fsid_localnode_map& fsidnodes, const LocalPath& fsName, std::unique_ptr<LocalPath> newshortname)
 {
-    if (fsid_lastSynced_it != fsidnodes.end())
+    if (fsid_lastSynced_inMap)
     {
         if (newfsid == fsid_lastSynced && localname == fsName)
         {
             return;
         }
 
-        fsidnodes.erase(fsid_lastSynced_it);
+        eraseAssociation(fsidnodes, fsid_lastSynced, this);
     }
 
     fsid_lastSynced = newfsid;
@@ -2655,13 +2889,10 @@ void LocalNode::setSyncedFsid(handle newfsid, fsid_localnode_map& fsidnodes, con
 
     // LOG_verbose << "localnode " << this << " fsid " << toHandle(fsid_lastSynced) << " localname " << fsName.toPath() << " parent " << parent;
 
-    if (fsid_lastSynced == UNDEF)
-    {
-        fsid_lastSynced_it = fsidnodes.end();
-    }
-    else
+    fsid_lastSynced_inMap = fsid_lastSynced != UNDEF;
+    if (fsid_lastSynced_inMap)
     {
-        fsid_lastSynced_it = fsidnodes.insert(std::make_pair(fsid_lastSynced, this));
+        fsidnodes.emplace(fsid_lastSynced, this);
     }
 
 //    assert(localname.empty() || name.empty() || (!parent && parent_dbid == UNDEF) || parent_dbid == 0 ||
@@ -2670,9 +2901,9 @@ void LocalNode::setSyncedFsid(handle newfsid, fsid_localnode_map& fsidnodes, con
 
 void LocalNode::setScannedFsid(handle newfsid, fsid_localnode_map& fsidnodes, const LocalPath& fsName, const FileFingerprint& scanfp)
 {
-    if (fsid_asScanned_it != fsidnodes.end())
+    if (fsid_asScanned_inMap)
     {
-        fsidnodes.erase(fsid_asScanned_it);
+        eraseAssociation(fsidnodes, fsid_asScanned, this);
     }
 
     fsid_asScanned = newfsid;
@@ -2680,13 +2911,10 @@ void LocalNode::setScannedFsid(handle newfsid, fsid_localnode_map& fsidnodes, co
 
     scannedFingerprint = scanfp;
 
-    if (fsid_asScanned == UNDEF)
+    fsid_asScanned_inMap = fsid_asScanned != UNDEF;
+    if (fsid_asScanned_inMap)
     {
-        fsid_asScanned_it = fsidnodes.end();
-    }
-    else
-    {
-        fsid_asScanned_it = fsidnodes.insert(std::make_pair(fsid_asScanned, this));
+        fsidnodes.emplace(fsid_asScanned, this);
     }
 
     assert(fsid_asScanned == UNDEF || 0 == compareUtf(localname, true, fsName, true, true));
@@ -2694,33 +2922,28 @@ void LocalNode::setScannedFsid(handle newfsid, fsid_localnode_map& fsidnodes, co
 
 void LocalNode::setSyncedNodeHandle(NodeHandle h)
 {
-    if (syncedCloudNodeHandle_it != sync->syncs.localnodeByNodeHandle.end())
+    if (syncedCloudNodeHandle_inMap)
     {
         if (h == syncedCloudNodeHandle)
         {
             return;
         }
 
-        assert(syncedCloudNodeHandle_it->first == syncedCloudNodeHandle);
-
         // too verbose for million-node syncs
         //LOG_verbose << sync->syncname << "removing synced handle " << syncedCloudNodeHandle << " for " << localnodedisplaypath(*sync->syncs.fsaccess);
 
-        sync->syncs.localnodeByNodeHandle.erase(syncedCloudNodeHandle_it);
+        eraseAssociation(sync->syncs.localnodeByNodeHandle, syncedCloudNodeHandle, this);
     }
 
     syncedCloudNodeHandle = h;
 
-    if (syncedCloudNodeHandle == UNDEF)
-    {
-        syncedCloudNodeHandle_it = sync->syncs.localnodeByNodeHandle.end();
-    }
-    else
+    syncedCloudNodeHandle_inMap = !syncedCloudNodeHandle.isUndef();
+    if (syncedCloudNodeHandle_inMap)
     {
         // too verbose for million-node syncs
         //LOG_verbose << sync->syncname << "adding synced handle " << syncedCloudNodeHandle << " for " << localnodedisplaypath(*sync->syncs.fsaccess);
 
-        syncedCloudNodeHandle_it = sync->syncs.localnodeByNodeHandle.insert(std::make_pair(syncedCloudNodeHandle, this));
+        sync->syncs.localnodeByNodeHandle.emplace(syncedCloudNodeHandle, this);
     }
 
 //    assert(localname.empty() || name.empty() || (!parent && parent_dbid == UNDEF) || parent_dbid == 0 ||
@@ -2755,17 +2978,17 @@ LocalNode::~LocalNode()
         sync->syncs.mMoveInvolvedLocalNodes.erase(this);
 
         // remove from fsidnode map, if present
-        if (fsid_lastSynced_it != sync->syncs.localnodeBySyncedFsid.end())
+        if (fsid_lastSynced_inMap)
         {
-            sync->syncs.localnodeBySyncedFsid.erase(fsid_lastSynced_it);
+            eraseAssociation(sync->syncs.localnodeBySyncedFsid, fsid_lastSynced, this);
         }
-        if (fsid_asScanned_it != sync->syncs.localnodeByScannedFsid.end())
+        if (fsid_asScanned_inMap)
         {
-            sync->syncs.localnodeByScannedFsid.erase(fsid_asScanned_it);
+            eraseAssociation(sync->syncs.localnodeByScannedFsid, fsid_asScanned, this);
         }
-        if (syncedCloudNodeHandle_it != sync->syncs.localnodeByNodeHandle.end())
+        if (syncedCloudNodeHandle_inMap)
         {
-            sync->syncs.localnodeByNodeHandle.erase(syncedCloudNodeHandle_it);
+            eraseAssociation(sync->syncs.localnodeByNodeHandle, syncedCloudNodeHandle, this);
         }
     }
 
@@ -2783,12 +3006,25 @@ LocalNode::~LocalNode()
 
 void LocalNode::deleteChildren()
 {
-    for (localnode_map::iterator it = children.begin(); it != children.end(); )
+    // Detach the children in bulk before deleting them.  Otherwise each
+    // child's destructor would call setnameparent(nullptr, ...), erasing it
+    // from our maps one entry at a time and re-walking its whole subtree to
+    // report a treestate that our own detach already reported (and which is
+    // suppressed anyway during sync teardown).  With parent already null the
+    // destructors skip all of that, so dropping a subtree of N nodes does
+    // O(N) work instead of re-traversing every nested subtree.
+    for (auto& child : children)
+    {
+        child.second->parent = nullptr;
+    }
+
+    for (auto& child : children)
     {
-        // the destructor removes the child from our `children` map
-        delete it++->second;
+        delete child.second;
     }
-    assert(children.empty());
+
+    children.clear();
+    schildren.clear();
 }
 
 
@@ -2842,13 +3078,47 @@ void LocalNode::getlocalpath(LocalPath& path) const
 {
     path.clear();
 
-    for (const LocalNode* l = this; l != nullptr; l = l->parent)
+    // Collect the chain first and build root-to-leaf: prepending shifts the
+    // whole buffer once per level, which is quadratic in tree depth.
+    const LocalNode* chain[64];
+    size_t n = 0;
+
+    const LocalNode* l = this;
+    for (; l != nullptr && n < sizeof(chain) / sizeof(*chain); l = l->parent)
     {
         assert(!l->parent || l->parent->sync == sync);
+        chain[n++] = l;
+    }
 
-        // sync root has absolute path, the rest are just their leafname
+    // in the (rare) case the tree is deeper than the chain buffer, build the
+    // topmost part the old way; the collected part is then appended below it
+    for (; l != nullptr; l = l->parent)
+    {
+        assert(!l->parent || l->parent->sync == sync);
         path.prependWithSeparator(l->localname);
     }
+
+    // one reservation covers all the components plus a separator for each,
+    // so the appends below never reallocate
+    size_t total = path.rawSize();
+    for (size_t i = 0; i < n; i++)
+    {
+        total += chain[i]->localname.rawSize() + 1;
+    }
+    path.reserve(total);
+
+    for (size_t i = n; i--; )
+    {
+        if (path.empty())
+        {
+            // sync root has absolute path, the rest are just their leafname
+            path = chain[i]->localname;
+        }
+        else
+        {
+            path.appendWithSeparator(chain[i]->localname, true);
+        }
+    }
 }
 
 string LocalNode::getCloudPath(bool guessLeafName) const
@@ -2867,6 +3137,9 @@ string LocalNode::getCloudPath(bool guessLeafName) const
         l = l->parent;
     }
 
+    // gather the names walking up, then join them root-to-leaf in one pass:
+    // insert(0, ...) per level re-copies the whole path each time
+    vector<string> names;
     for (; l != nullptr; l = l->parent)
     {
         string name;
@@ -2885,12 +3158,33 @@ string LocalNode::getCloudPath(bool guessLeafName) const
 
         assert(!l->parent || l->parent->sync == sync);
 
-        if (!path.empty())
-            path.insert(0, 1, '/');
+        names.emplace_back(l->parent ? std::move(name) : std::move(fullpath));
+    }
+
+    // a separator follows a name only if anything non-empty comes below it,
+    // matching the old "only separate a non-empty path" prepend rule
+    vector<bool> nonEmptyBelow(names.size());
+    bool seen = !path.empty();
+    size_t total = path.size();
+    for (size_t j = 0; j < names.size(); ++j)
+    {
+        nonEmptyBelow[j] = seen;
+        seen = seen || !names[j].empty();
+        total += names[j].size() + 1;
+    }
 
-        path.insert(0, l->parent ? name : fullpath);
+    string result;
+    result.reserve(total);
+    for (size_t i = names.size(); i--; )
+    {
+        result.append(names[i]);
+        if (nonEmptyBelow[i])
+        {
+            result.append(1, '/');
+        }
     }
-    return path;
+    result.append(path);
+    return result;
 }
 
 
@@ -2959,6 +3253,24 @@ FSNode LocalNode::getScannedFSDetails() const
     return n;
 }
 
+// Same comparison as getScannedFSDetails().equivalentTo(n), but without
+// materialising the temporary FSNode (and its LocalPath copies)
+bool LocalNode::scannedFSDetailsEquivalentTo(const FSNode& n) const
+{
+    if (type != n.type) return false;
+
+    if (fsid_asScanned != n.fsid) return false;
+
+    if (n.isSymlink) return false;
+
+    if (type == FILENODE && !(scannedFingerprint == n.fingerprint)) return false;
+
+    if (localname != n.localname) return false;
+
+    return (!slocalname && (!n.shortname || localname == *n.shortname))
+           || (slocalname && n.shortname && *slocalname == *n.shortname);
+}
+
 void LocalNode::updateMoveInvolvement()
 {
     bool moveInvolved = hasRare() && (rare().moveToHere || rare().moveFromHere);
@@ -3065,7 +3377,9 @@ bool LocalNode::transferResetUnlessMatched(direction_t dir, const FileFingerprin
 {
     if (!transferSP) return true;
 
-    auto uploadPtr = dynamic_cast<SyncUpload_inClient*>(transferSP.get());
+    auto uploadPtr = transferSP->direction == PUT
+        ? static_cast<SyncUpload_inClient*>(transferSP.get())
+        : nullptr;
 
     auto different =
       dir != (uploadPtr ? PUT : GET)
@@ -3110,7 +3424,7 @@ bool LocalNodeCore::write(string& destination, uint32_t parentID) const
     w.serializehandle(fsid_lastSynced);
     w.serializeu32(parentID);
     w.serializenodehandle(syncedCloudNodeHandle.as8byte());
-    w.serializestring(localname.platformEncoded());
+    localname.serializePlatformEncoded(w);
     if (type == FILENODE)
     {
         if (syncedFingerprint.isvalid)
@@ -3134,8 +3448,14 @@ bool LocalNodeCore::write(string& destination, uint32_t parentID) const
     // first flag indicates we are storing slocalname.
     // Storing it is much, much faster than looking it up on startup.
     w.serializeexpansionflags(1, 1);
-    auto tmpstr = slocalname ? slocalname->platformEncoded() : string();
-    w.serializepstr(slocalname ? &tmpstr : nullptr);
+    if (slocalname)
+    {
+        slocalname->serializePlatformEncoded(w);
+    }
+    else
+    {
+        w.serializepstr(nullptr);
+    }
 
     w.serializebool(namesSynchronized);
 
@@ -3156,7 +3476,10 @@ bool LocalNode::serialize(string* d) const
     // The only node with a zero DBID should be the root.
     assert(parent->dbid || !parent->parent);
 
-#ifdef DEBUG
+// This cross-check against the live filesystem costs an fopen/shortname
+// syscall pair per node, which throttles sync DB flushes to disk IOPS in
+// debug builds.  Define this to turn it on.
+#if defined(DEBUG) && defined(MEGA_DEBUG_FS_ASSERTIONS)
     if (fsid_lastSynced != UNDEF)
     {
         LocalPath localpath = getLocalPath();
@@ -3183,7 +3506,9 @@ bool LocalNode::serialize(string* d) const
     auto parentID = parent ? parent->dbid : 0;
     auto result = LocalNodeCore::write(*d, parentID);
 
-#ifdef DEBUG
+// The round-trip parse below is pure CPU but still a full unserialize per
+// node written; gate it separately from the filesystem assertions above.
+#if defined(DEBUG) && defined(MEGA_DEBUG_SERIALIZE_ROUNDTRIP)
     // Quick (de)serizliation check.
     {
         string source = *d;
@@ -3221,16 +3546,11 @@ bool LocalNodeCore::read(const string& source, uint32_t& parentID)
 
     if (!r.unserializei64(size)) return false;
 
-    if (size < 0 && size >= -FOLDERNODE)
-    {
-        // will any compiler optimize this to a const assignment?
-        type = (nodetype_t)-size;
-        size = 0;
-    }
-    else
-    {
-        type = FILENODE;
-    }
+    // both selects compile to conditional moves; files and folders are
+    // interleaved in the DB, so an actual branch here predicts poorly
+    const bool isNonFile = size < 0 && size >= -FOLDERNODE;
+    type = isNonFile ? (nodetype_t)-size : FILENODE;
+    size = isNonFile ? 0 : size;
 
     handle fsid;
     handle h = 0;
@@ -3262,8 +3582,10 @@ bool LocalNodeCore::read(const string& source, uint32_t& parentID)
     this->type = type;
     this->syncedFingerprint.size = size;
     this->fsid_lastSynced = fsid;
-    this->localname = LocalPath::fromPlatformEncodedRelative(localname);
-    this->slocalname.reset(shortname.empty() ? nullptr : new LocalPath(LocalPath::fromPlatformEncodedRelative(shortname)));
+    // the decoded buffers are moved into the LocalPaths, so each name is
+    // allocated exactly once (by unserializestring/unserializecstr above)
+    this->localname = LocalPath::fromPlatformEncodedRelative(std::move(localname));
+    this->slocalname.reset(shortname.empty() ? nullptr : new LocalPath(LocalPath::fromPlatformEncodedRelative(std::move(shortname))));
     this->slocalname_in_db = 0 != expansionflags[0];
     this->namesSynchronized = ns;
 
@@ -3430,25 +3752,47 @@ ExclusionState LocalNode::calcExcluded(RemotePathPair namePath, nodetype_t type,
     // This specialization only makes sense for directories.
     assert(this->type == FOLDERNODE);
 
-    // Check whether the file is excluded by any filters.
+    // Filter chains are rare; find the highest ancestor that has one so the
+    // climb (and the relative-path building it needs) can stop there.  New
+    // nodes on deep, unfiltered trees then never walk to the root at all.
+    const LocalNode* highest = nullptr;
+
     for (auto* node = this; node; node = node->parent)
     {
         assert(node->mExclusionState == ES_INCLUDED);
 
+        if (node->rareRO().filterChain &&
+            (node == this || node->rareRO().filterChain->hasInheritableRules()))
+            highest = node;
+    }
+
+    // Check whether the file is excluded by any filters.
+    for (auto* node = this; highest; node = node->parent)
+    {
         if (node->rareRO().filterChain)
         {
             // Should we only consider inheritable filter rules?
             inherited = inherited || node != this;
 
-            // Check for a filter match.
-            auto result = node->filterChainRO().match(namePath, type, inherited);
+            // Chains whose rules all stop at their own directory have
+            // nothing that could match an inherited query.
+            if (!inherited || node->filterChainRO().hasInheritableRules())
+            {
+                // Check for a filter match.
+                auto result = node->filterChainRO().match(namePath, type, inherited);
 
-            // Was the file matched by any filters?
-            if (result != ES_UNMATCHED)
-                return result;
+                // Was the file matched by any filters?
+                if (result != ES_UNMATCHED)
+                    return result;
+            }
         }
 
+        if (node == highest)
+            break;
+
         // Update path so that it's applicable to the next node's path filters.
+        // toName_of_localname is the cached cloud-name conversion (kept up to
+        // date by setnameparent), so this is a prepend, not a re-escape.
         namePath.second.prependWithSeparator(node->toName_of_localname);
     }
 
@@ -3510,11 +3854,19 @@ void LocalNode::setRecomputeExclusionState(bool includingThisOne, bool scan)
     if (type == FILENODE)
         return;
 
-    list<LocalNode*> pending(1, this);
+    // plain LIFO stack: visit order doesn't matter for invalidation, and a
+    // vector avoids the per-visited-node allocation a list would make.
+    // The walk reads one flag and the type per child; nodes come from the
+    // LocalNode slab pool, so children allocated together tend to sit on
+    // neighbouring cache lines already
+    vector<LocalNode*> pending;
+    pending.reserve(64);
+    pending.push_back(this);
 
     while (!pending.empty())
     {
-        auto& node = *pending.front();
+        auto& node = *pending.back();
+        pending.pop_back();
 
         for (auto& childIt : node.children)
         {
@@ -3527,14 +3879,12 @@ void LocalNode::setRecomputeExclusionState(bool includingThisOne, bool scan)
 
             if (child.type == FOLDERNODE)
             {
-                pending.emplace_back(&child);
+                pending.push_back(&child);
 
                 // make sure we visit this node later and recalculate exclusions
                 child.setSyncAgain(false, true, true);
             }
         }
-
-        pending.pop_front();
     }
 }
 
@@ -3598,11 +3948,14 @@ LocalNode::exclusionState(const PathType& path, nodetype_t type, m_off_t size) c
     // Current path component.
     PathType component;
 
+    // hoisted: one indirection instead of two loads per component
+    FileSystemAccess& fsaccess = *sync->syncs.fsaccess;
+
     // Check if any intermediary path components are excluded.
     for (size_t index = 0; path.nextPathComponent(index, component); )
     {
         // Compute cloud name.
-        namePath.first = component.toName(*sync->syncs.fsaccess);
+        namePath.first = component.toName(fsaccess);
 
         // Compute relative cloud path.
         namePath.second.appendWithSeparator(namePath.first, false);
@@ -186,7 +186,7 @@ bool NodeManager::addNode_internal(std::shared_ptr<Node> node, bool notify, bool
     // 'notify' is false when loading nodes from API or DB. True when node is received from
     // actionpackets and/or from response of CommandPutnodes
 
-    bool rootNode = node->type == ROOTNODE || node->type == RUBBISHNODE || node->type == VAULTNODE;
+    bool rootNode = isRootNodeType(node->type);
 
     // getRootNodeFiles() is always set for folder links before adding any node (upon login)
     bool isFolderLink = rootnodes.files == node->nodeHandle();
@@ -212,8 +212,7 @@ bool NodeManager::addNode_internal(std::shared_ptr<Node> node, bool notify, bool
         // when keepNodeInMemory is true, NodeManager::addChild is called by Node::setParent (from NodeManager::saveNodeInRAM)
         auto pair = mNodes.emplace(node->nodeHandle(), NodeManagerNode(*this, node->nodeHandle()));
         // The NodeManagerNode could have been added by NodeManager::addChild() but, in that case, mNode would be invalid
-        auto& nodePosition = pair.first;
-        nodePosition->second.mAllChildrenHandleLoaded = true; // Receive a new node, children aren't received yet or they are stored in nodesWithMissingParents
+        pair.first->second.mAllChildrenHandleLoaded = true; // Receive a new node, children aren't received yet or they are stored in nodesWithMissingParents
         addChild_internal(node->parentHandle(), node->nodeHandle(), nullptr);
     }
 
@@ -283,14 +282,14 @@ sharedNode_list NodeManager::getChildren_internal(const Node *parent, CancelToke
     }
 
     // if handles of all children are known, load missing child nodes one by one
-    if (parent->mNodePosition->second.mAllChildrenHandleLoaded)
+    if (parent->mNodePosition->mAllChildrenHandleLoaded)
     {
-        if (!parent->mNodePosition->second.mChildren)
+        if (!parent->mNodePosition->mChildren)
         {
             return childrenList;
         }
 
-        for (const auto &child : *parent->mNodePosition->second.mChildren)
+        for (const auto &child : *parent->mNodePosition->mChildren)
         {
             if (cancelToken.isCancelled())
             {
@@ -315,9 +314,9 @@ sharedNode_list NodeManager::getChildren_internal(const Node *parent, CancelToke
     }
     else // get all children from DB directly and load missing ones
     {
-        if (parent->mNodePosition->second.mChildren)
+        if (parent->mNodePosition->mChildren)
         {
-            for (const auto& child : *parent->mNodePosition->second.mChildren)
+            for (const auto& child : *parent->mNodePosition->mChildren)
             {
                 if (child.second)
                 {
@@ -334,9 +333,9 @@ sharedNode_list NodeManager::getChildren_internal(const Node *parent, CancelToke
             return  childrenList;
         }
 
-        if (!nodesFromTable.empty() && !parent->mNodePosition->second.mChildren)
+        if (!nodesFromTable.empty() && !parent->mNodePosition->mChildren)
         {
-            parent->mNodePosition->second.mChildren = ::mega::make_unique<std::map<NodeHandle, NodeManagerNode*>>();
+            parent->mNodePosition->mChildren = ::mega::make_unique<std::map<NodeHandle, NodeManagerNode*>>();
         }
 
         for (const auto& nodeSerializedIt : nodesFromTable)
@@ -347,8 +346,8 @@ sharedNode_list NodeManager::getChildren_internal(const Node *parent, CancelToke
                 return  childrenList;
             }
 
-            auto childIt = parent->mNodePosition->second.mChildren->find(nodeSerializedIt.first);
-            if (childIt == parent->mNodePosition->second.mChildren->end() || !childIt->second) // handle or node not loaded
+            auto childIt = parent->mNodePosition->mChildren->find(nodeSerializedIt.first);
+            if (childIt == parent->mNodePosition->mChildren->end() || !childIt->second) // handle or node not loaded
             {
                 auto itNode = mNodes.find(nodeSerializedIt.first);
                 if ( itNode == mNodes.end() || !itNode->second.getNodeInRam())    // not loaded
@@ -369,7 +368,7 @@ sharedNode_list NodeManager::getChildren_internal(const Node *parent, CancelToke
             }
         }
 
-        parent->mNodePosition->second.mAllChildrenHandleLoaded = true;
+        parent->mNodePosition->mAllChildrenHandleLoaded = true;
     }
 
     return childrenList;
@@ -651,11 +650,12 @@ sharedNode_vector NodeManager::getNodesByFingerprint_internal(FileFingerprint &f
     // Take first nodes in RAM
     std::set<NodeHandle> fpLoaded;
     auto p = mFingerPrints.equal_range(&fingerprint);
+    nodes.reserve(static_cast<size_t>(std::distance(p.first, p.second)));
     for (auto it = p.first; it != p.second; ++it)
     {
         Node* node = static_cast<Node*>(*it);
         fpLoaded.emplace(node->nodeHandle());
-        std::shared_ptr<Node> sharedNode = node->mNodePosition->second.getNodeInRam();
+        std::shared_ptr<Node> sharedNode = node->mNodePosition->getNodeInRam();
         assert(sharedNode);
         nodes.push_back(sharedNode);
     }
@@ -741,7 +741,7 @@ std::shared_ptr<Node> NodeManager::getNodeByFingerprint_internal(FileFingerprint
     {
         Node *n = static_cast<Node*>(*it);
         assert(n);
-        return n->mNodePosition->second.getNodeInRam();
+        return n->mNodePosition->getNodeInRam();
     }
 
     NodeSerialized nodeSerialized;
@@ -776,16 +776,16 @@ std::shared_ptr<Node> NodeManager::childNodeByNameType_internal(const Node* pare
 
     // mAllChildrenHandleLoaded = false -> if not found, need check DB
     // mAllChildrenHandleLoaded = true  -> if all children have a pointer, no need to check DB
-    bool allChildrenLoaded = parent->mNodePosition->second.mAllChildrenHandleLoaded;
+    bool allChildrenLoaded = parent->mNodePosition->mAllChildrenHandleLoaded;
 
-    if (allChildrenLoaded && !parent->mNodePosition->second.mChildren)
+    if (allChildrenLoaded && !parent->mNodePosition->mChildren)
     {
         return nullptr; // valid case
     }
 
-    if (parent->mNodePosition->second.mChildren)
+    if (parent->mNodePosition->mChildren)
     {
-        for (const auto& itNode : *parent->mNodePosition->second.mChildren)
+        for (const auto& itNode : *parent->mNodePosition->mChildren)
         {
             if (itNode.second)
             {
@@ -822,6 +822,94 @@ std::shared_ptr<Node> NodeManager::childNodeByNameType_internal(const Node* pare
     return getNodeFromNodeSerialized(nodeSerialized.second);
 }
 
+std::shared_ptr<Node> NodeManager::childNodeByNameFolderFirst(const Node* parent, const std::string &name)
+{
+    LockGuard g(mMutex);
+    return childNodeByNameFolderFirst_internal(parent, name);
+}
+
+std::shared_ptr<Node> NodeManager::childNodeByNameFolderFirst_internal(const Node* parent, const std::string &name)
+{
+    assert(mMutex.owns_lock());
+
+    if (!mTable || mNodes.empty())
+    {
+        assert(false);
+        return nullptr;
+    }
+
+    // mAllChildrenHandleLoaded = false -> if not found, need check DB
+    // mAllChildrenHandleLoaded = true  -> if all children have a pointer, no need to check DB
+    bool allChildrenLoaded = parent->mNodePosition->mAllChildrenHandleLoaded;
+
+    if (allChildrenLoaded && !parent->mNodePosition->mChildren)
+    {
+        return nullptr; // valid case
+    }
+
+    // one pass over the children in RAM, checking both types at once
+    std::shared_ptr<Node> fileMatch;
+    if (parent->mNodePosition->mChildren)
+    {
+        for (const auto& itNode : *parent->mNodePosition->mChildren)
+        {
+            if (itNode.second)
+            {
+                shared_ptr<Node> node = itNode.second->getNodeInRam();
+                if (node)
+                {
+                    if ((node->type == FOLDERNODE || node->type == FILENODE) && name == node->displayname())
+                    {
+                        if (node->type == FOLDERNODE)
+                        {
+                            return node;    // folder matches take precedence
+                        }
+                        else if (!fileMatch)
+                        {
+                            fileMatch = node;
+                        }
+                    }
+                }
+                else
+                {
+                    // If not all child nodes have been loaded, check the DB
+                    allChildrenLoaded = false;
+                }
+            }
+            else
+            {
+                allChildrenLoaded = false;
+            }
+        }
+    }
+
+    if (allChildrenLoaded)
+    {
+        return fileMatch;
+    }
+
+    // a folder match could still be among the children not loaded in RAM
+    std::pair<NodeHandle, NodeSerialized> nodeSerialized;
+    if (mTable->childNodeByNameType(parent->nodeHandle(), name, FOLDERNODE, nodeSerialized))
+    {
+        assert(!getNodeInRAM(nodeSerialized.first));  // not loaded yet
+        return getNodeFromNodeSerialized(nodeSerialized.second);
+    }
+
+    if (fileMatch)
+    {
+        return fileMatch;
+    }
+
+    if (mTable->childNodeByNameType(parent->nodeHandle(), name, FILENODE, nodeSerialized))
+    {
+        assert(!getNodeInRAM(nodeSerialized.first));  // not loaded yet
+        return getNodeFromNodeSerialized(nodeSerialized.second);
+    }
+
+    return nullptr;  // Not found at DB either
+}
+
 sharedNode_vector NodeManager::getRootNodes()
 {
     LockGuard g(mMutex);
@@ -1036,80 +1124,141 @@ void NodeManager::updateTreeCounter(std::shared_ptr<Node> origin, NodeCounter nc
     }
 }
 
-NodeCounter NodeManager::calculateNodeCounter(const NodeHandle& nodehandle, nodetype_t parentType, std::shared_ptr<Node> node, bool isInRubbish)
+NodeCounter NodeManager::calculateNodeCounter(const NodeHandle& nodehandle, nodetype_t parentType, std::shared_ptr<Node> node, bool isInRubbish, NodeManagerNode* nmNode)
 {
     assert(mMutex.owns_lock());
 
-    NodeCounter nc;
+    NodeCounter result;
     if (!mTable)
     {
         assert(false);
-        return nc;
+        return result;
     }
 
-    m_off_t nodeSize = 0u;
-    uint64_t flags = 0;
-    nodetype_t nodeType = TYPE_UNKNOWN;
-    if (node)
+    // iterative post-order walk: each frame accumulates its children's
+    // counters before adding its own contribution, so arbitrarily deep trees
+    // don't burn a stack frame (and the per-frame locals) per node
+    struct Frame
     {
-        nodeType = node->type;
-        nodeSize = node->size;
-        flags = node->getDBFlags();
-    }
-    else
+        NodeHandle handle;
+        nodetype_t parentType;
+        std::shared_ptr<Node> node;
+        NodeManagerNode* nmNode;
+
+        nodetype_t nodeType = TYPE_UNKNOWN;
+        m_off_t nodeSize = 0;
+        uint64_t flags = 0;
+        NodeCounter nc;
+        std::map<NodeHandle, NodeManagerNode*>::iterator nextChild;
+        bool expanded = false;
+
+        Frame(NodeHandle h, nodetype_t pt, std::shared_ptr<Node> n, NodeManagerNode* nmn)
+            : handle(h), parentType(pt), node(std::move(n)), nmNode(nmn) {}
+    };
+
+    std::vector<Frame> stack;
+    stack.emplace_back(nodehandle, parentType, std::move(node), nmNode);
+
+    while (!stack.empty())
     {
-        if (!mTable->getNodeSizeTypeAndFlags(nodehandle, nodeSize, nodeType, flags))
         {
-            assert(false);
-            return nc;
+            Frame& f = stack.back();
+
+            if (!f.expanded)
+            {
+                f.expanded = true;
+
+                if (f.node)
+                {
+                    f.nodeType = f.node->type;
+                    f.nodeSize = f.node->size;
+                    // The rubbish/version classification is already known from
+                    // the walk down the tree; don't re-walk every node's
+                    // ancestor chain to the root (which is what getDBFlags()
+                    // would do via isAncestor)
+                    f.flags = Node::getDBFlags(0, isInRubbish, f.parentType == FILENODE, f.node->isMarkedSensitive());
+                }
+                else
+                {
+                    if (!mTable->getNodeSizeTypeAndFlags(f.handle, f.nodeSize, f.nodeType, f.flags))
+                    {
+                        assert(false);
+                        // drop this subtree, contributing nothing to the parent
+                        stack.pop_back();
+                        continue;
+                    }
+                    std::bitset<Node::FLAGS_SIZE> bitset(f.flags);
+                    f.flags = Node::getDBFlags(f.flags, isInRubbish, f.parentType == FILENODE, bitset.test(Node::FLAGS_IS_MARKED_SENSTIVE));
+                }
+
+                if (!f.nmNode)
+                {
+                    // child frames supply the position directly, so the lookup
+                    // only happens for the root of the calculation
+                    auto it = mNodes.find(f.handle);
+                    if (it != mNodes.end())
+                    {
+                        f.nmNode = &it->second;
+                    }
+                }
+
+                if (f.nmNode && f.nmNode->mChildren)
+                {
+                    f.nextChild = f.nmNode->mChildren->begin();
+                }
+            }
+
+            if (f.nmNode && f.nmNode->mChildren && f.nextChild != f.nmNode->mChildren->end())
+            {
+                auto childIt = f.nextChild++;
+                shared_ptr<Node> child = childIt->second ? childIt->second->getNodeInRam() : nullptr;
+                // careful: invalidates f
+                stack.emplace_back(childIt->first, f.nodeType, std::move(child), childIt->second);
+                continue;
+            }
         }
-        std::bitset<Node::FLAGS_SIZE> bitset(flags);
-        flags = Node::getDBFlags(flags, isInRubbish, parentType == FILENODE, bitset.test(Node::FLAGS_IS_MARKED_SENSTIVE));
-    }
 
-    std::map<NodeHandle, NodeManagerNode*>* children = nullptr;
-    auto it = mNodes.find(nodehandle);
-    if (it != mNodes.end())
-    {
-        children = it->second.mChildren.get();
-    }
+        // children done: add this node's own contribution and pop
+        Frame f = std::move(stack.back());
+        stack.pop_back();
 
-    if (children)
-    {
-        for (auto& itNode : *children)
+        if (f.nodeType == FILENODE)
         {
-            shared_ptr<Node> child = itNode.second ? itNode.second->getNodeInRam() : nullptr;
-            nc += calculateNodeCounter(itNode.first, nodeType, child, isInRubbish);
+            bool isVersion = f.parentType == FILENODE;
+            if (isVersion)
+            {
+                f.nc.versions++;
+                f.nc.versionStorage += f.nodeSize;
+            }
+            else
+            {
+                f.nc.files++;
+                f.nc.storage += f.nodeSize;
+            }
+        }
+        else if (f.nodeType == FOLDERNODE)
+        {
+            f.nc.folders++;
         }
-    }
 
-    if (nodeType == FILENODE)
-    {
-        bool isVersion = parentType == FILENODE;
-        if (isVersion)
+        if (f.node)
         {
-            nc.versions++;
-            nc.versionStorage += nodeSize;
+            setNodeCounter(f.node, f.nc, false, nullptr);
+        }
+
+        mTable->updateCounterAndFlags(f.handle, f.flags, f.nc.serialize());
+
+        if (stack.empty())
+        {
+            result = f.nc;
         }
         else
         {
-            nc.files++;
-            nc.storage += nodeSize;
+            stack.back().nc += f.nc;
         }
     }
-    else if (nodeType == FOLDERNODE)
-    {
-        nc.folders++;
-    }
-
-    if (node)
-    {
-        setNodeCounter(node, nc, false, nullptr);
-    }
-
-    mTable->updateCounterAndFlags(nodehandle, flags, nc.serialize());
 
-    return nc;
+    return result;
 }
 
 
@@ -1269,9 +1418,9 @@ shared_ptr<Node> NodeManager::unserializeNode(const std::string *d, bool fromOld
         // The NodeManagerNode could have been added in the initial fetch nodes (without session)
         // Now, the node is loaded from DB, NodeManagerNode is updated with correct values
         mNodesInRam++;
-        auto& nodePosition = pair.first;
-        nodePosition->second.setNode(n);
-        n->mNodePosition = nodePosition;
+        NodeManagerNode& nmNode = pair.first->second;
+        nmNode.setNode(n);
+        n->mNodePosition = &nmNode;
 
         // setparent() skiping update of node counters, since they are already calculated in DB
         // In DB migration we have to calculate them as they aren't calculated previously
@@ -1396,8 +1545,8 @@ void NodeManager::notifyPurge()
                 removeFingerprint(n.get());
 
                 mNodesInRam--;
-                mNodes.erase(n->mNodePosition);
-                n->mNodePosition = mNodes.end();
+                mNodes.erase(n->nodeHandle());
+                n->mNodePosition = nullptr;
 
                 mTable->remove(h);
 
@@ -1479,10 +1628,10 @@ void NodeManager::saveNodeInRAM(std::shared_ptr<Node> node, bool isRootnode, Mis
     auto pair = mNodes.emplace(node->nodeHandle(), NodeManagerNode(*this, node->nodeHandle()));
     // The NodeManagerNode could have been added by NodeManager::addChild() but, in that case, mNode would be invalid
     mNodesInRam++;
-    auto& nodePosition = pair.first;
-    nodePosition->second.setNode(node);
-    nodePosition->second.mAllChildrenHandleLoaded = true; // Receive a new node, children aren't received yet or they are stored a mNodesWithMissingParents
-    node->mNodePosition = nodePosition;
+    NodeManagerNode& nmNode = pair.first->second;
+    nmNode.setNode(node);
+    nmNode.mAllChildrenHandleLoaded = true; // Receive a new node, children aren't received yet or they are stored a mNodesWithMissingParents
+    node->mNodePosition = &nmNode;
 
     // In case of rootnode, no need to add to missingParentNodes
     if (!isRootnode)
@@ -1718,13 +1867,13 @@ void NodeManager::updateCounter_internal(std::shared_ptr<Node> n, std::shared_pt
     updateTreeCounter(n->parent, nc, INCREASE, nullptr);
 }
 
-FingerprintPosition NodeManager::insertFingerprint(Node *node)
+bool NodeManager::insertFingerprint(Node *node)
 {
     LockGuard g(mMutex);
     return insertFingerprint_internal(node);
 }
 
-FingerprintPosition NodeManager::insertFingerprint_internal(Node *node)
+bool NodeManager::insertFingerprint_internal(Node *node)
 {
     assert(mMutex.owns_lock());
 
@@ -1732,10 +1881,11 @@ FingerprintPosition NodeManager::insertFingerprint_internal(Node *node)
     // since it will be invalid once node is written to DB
     if (node->type == FILENODE && mNodeToWriteInDb.get() != node)
     {
-        return mFingerPrints.insert(node);
+        mFingerPrints.insert(node);
+        return true;
     }
 
-    return mFingerPrints.end();
+    return false;
 }
 
 void NodeManager::removeFingerprint(Node *node, bool unloadNode)
@@ -1748,10 +1898,20 @@ void NodeManager::removeFingerprint_internal(Node *node, bool unloadNode)
 {
     assert(mMutex.owns_lock());
 
-    if (node->type == FILENODE && node->mFingerPrintPosition != mFingerPrints.end())  // remove from mFingerPrints
+    if (node->type == FILENODE && node->mFingerPrintInContainer)  // remove from mFingerPrints
     {
-        mFingerPrints.erase(node->mFingerPrintPosition);
-        node->mFingerPrintPosition = mFingerPrints.end();
+        // the hashed set invalidates iterators on rehash, so re-find the
+        // entry; the scan only covers nodes with an identical fingerprint
+        auto range = mFingerPrints.equal_range(node);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (*it == static_cast<FileFingerprint*>(node))
+            {
+                mFingerPrints.erase(it);
+                break;
+            }
+        }
+        node->mFingerPrintInContainer = false;
 
         if (unloadNode)
         {
@@ -1761,12 +1921,6 @@ void NodeManager::removeFingerprint_internal(Node *node, bool unloadNode)
     }
 }
 
-FingerprintPosition NodeManager::invalidFingerprintPos()
-{
-    // no locking for this one, it returns a constant
-    return mFingerPrints.end();
-}
-
 void NodeManager::dumpNodes()
 {
     LockGuard g(mMutex);
@@ -1838,21 +1992,27 @@ void NodeManager::addChild_internal(NodeHandle parent, NodeHandle child, Node* n
 {
     assert(mMutex.owns_lock());
 
-    auto pair = mNodes.emplace(parent, NodeManagerNode(*this, parent));
-    // The NodeManagerNode could have been added in add node, only update the child
-    if (!pair.first->second.mChildren)
+    // The NodeManagerNode could have been added in add node, only update the child.
+    // Most attaches find the parent entry already present, so look it up first
+    // instead of constructing a throwaway NodeManagerNode for emplace to discard.
+    auto it = mNodes.find(parent);
+    if (it == mNodes.end())
+    {
+        it = mNodes.emplace(parent, NodeManagerNode(*this, parent)).first;
+    }
+    if (!it->second.mChildren)
     {
-        pair.first->second.mChildren = ::mega::make_unique<std::map<NodeHandle,  NodeManagerNode*>>();
+        it->second.mChildren = ::mega::make_unique<std::map<NodeHandle,  NodeManagerNode*>>();
     }
 
     NodeManagerNode *nodeManagerNode = nullptr;
     if (node)
     {
-        assert(node->mNodePosition != mNodes.end());
-        nodeManagerNode = &node->mNodePosition->second;
+        assert(node->mNodePosition);
+        nodeManagerNode = node->mNodePosition;
     }
 
-    (*pair.first->second.mChildren)[child] = nodeManagerNode;
+    (*it->second.mChildren)[child] = nodeManagerNode;
 }
 
 void NodeManager::removeChild(Node* parent, NodeHandle child)
@@ -1865,10 +2025,10 @@ void NodeManager::removeChild_internal(Node* parent, NodeHandle child)
 {
     assert(mMutex.owns_lock());
 
-    assert(parent->mNodePosition->second.mChildren);
-    if (parent->mNodePosition->second.mChildren)
+    assert(parent->mNodePosition->mChildren);
+    if (parent->mNodePosition->mChildren)
     {
-        parent->mNodePosition->second.mChildren->erase(child);
+        parent->mNodePosition->mChildren->erase(child);
     }
 }
 
@@ -455,6 +455,10 @@ void PosixFileAccess::asyncsysread(AsyncIOContext *context)
 #endif
 }
 
+// Async writes go through POSIX AIO (glibc services these from a small thread
+// pool).  An io_uring backend would batch submissions without per-op thread
+// wakeups, but needs liburing plus kernel 5.6+ detection at runtime; revisit
+// if the write side ever shows up ahead of decryption in profiles.
 void PosixFileAccess::asyncsyswrite(AsyncIOContext *context)
 {
 #ifdef HAVE_AIO_RT
@@ -538,6 +542,18 @@ bool PosixFileAccess::fwrite(const byte* data, unsigned len, m_off_t pos)
 #endif
 }
 
+void PosixFileAccess::fadviseDontNeed(m_off_t offset, m_off_t len)
+{
+#ifdef POSIX_FADV_DONTNEED
+    // best effort: dirty pages aren't dropped until written back, but repeated
+    // hints over a long download still keep its pages from crowding the cache
+    posix_fadvise(fd, offset, len, POSIX_FADV_DONTNEED);
+#else
+    (void)offset;
+    (void)len;
+#endif
+}
+
 bool PosixFileAccess::ftruncate()
 {
     retry = false;
@@ -1647,6 +1663,10 @@ LinuxDirNotify::~LinuxDirNotify()
 
 #if defined(USE_INOTIFY)
 
+// One inotify_add_watch syscall per directory is inherent in the API:
+// inotify has no batched registration, and fanotify's filesystem-wide
+// marks both require CAP_SYS_ADMIN and report events in a form that
+// doesn't map onto our per-directory WatchMap.
 AddWatchResult LinuxDirNotify::addWatch(LocalNode& node,
     const LocalPath& path,
     handle fsid)
@@ -1812,7 +1832,7 @@ private:
 
 ScanResult PosixFileSystemAccess::directoryScan(const LocalPath& targetPath,
                                                 handle expectedFsid,
-                                                map<LocalPath, FSNode>& known,
+                                                fsnode_map& known,
                                                 std::vector<FSNode>& results,
                                                 bool followSymLinks,
                                                 unsigned& nFingerprinted)
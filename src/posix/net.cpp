@@ -2677,6 +2677,7 @@ size_t CurlHttpIO::check_header(void* ptr, size_t size, size_t nmemb, void* targ
     else if (len > 15 && !memcmp(ptr, "Content-Type:", 13))
     {
         req->contenttype.assign((char *)ptr + 13, len - 15);
+        req->contentTypeIsHtml = req->contenttype.find("text/html") != string::npos;
     }
     else
     {
@@ -44,16 +44,17 @@ void PubKeyActionPutNodes::proc(MegaClient* client, User* u)
         int t;
 
         // re-encrypt all node keys to the user's public key
-        for (size_t i = nn.size(); i--;)
+        // (forward order, so the hardware prefetcher follows the vector)
+        for (NewNode& n : nn)
         {
-            if (!(t = u->pubk.encrypt(client->rng, (const byte*)nn[i].nodekey.data(), nn[i].nodekey.size(), buf, sizeof buf)))
+            if (!(t = u->pubk.encrypt(client->rng, (const byte*)n.nodekey.data(), n.nodekey.size(), buf, sizeof buf)))
             {
                 if (completion) completion(API_EINTERNAL, USER_HANDLE, nn, false, tag);
                 else client->app->putnodes_result(API_EINTERNAL, USER_HANDLE, nn, false, tag);
                 return;
             }
 
-            nn[i].nodekey.assign((char*)buf, t);
+            n.nodekey.assign((char*)buf, t);
         }
 
         client->reqs.add(new CommandPutNodes(client, NodeHandle(), u->uid.c_str(), NoVersioning, std::move(nn), tag, PUTNODES_APP, nullptr, std::move(completion), false));
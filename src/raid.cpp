@@ -30,6 +30,33 @@
 namespace mega
 {
 
+namespace {
+
+// Slab pool backing the pooled operator new/delete of FilePiece: one is
+// allocated per completed chunk (six at a time for raid) and released as
+// soon as its data is written out, possibly from a worker thread.
+SlabPool& filePieceSlabPool()
+{
+    static SlabPool pool(sizeof(RaidBufferManager::FilePiece));
+    return pool;
+}
+
+} // anonymous namespace
+
+void* RaidBufferManager::FilePiece::operator new(size_t size)
+{
+    assert(size == sizeof(RaidBufferManager::FilePiece));
+    return filePieceSlabPool().alloc();
+}
+
+void RaidBufferManager::FilePiece::operator delete(void* p)
+{
+    if (p)
+    {
+        filePieceSlabPool().release(p);
+    }
+}
+
 const unsigned RAID_ACTIVE_CHANNEL_FAIL_THRESHOLD = 5;
 
 struct FaultyServers
@@ -114,7 +141,7 @@ RaidBufferManager::FilePiece::FilePiece()
 
 RaidBufferManager::FilePiece::FilePiece(m_off_t p, size_t len)
     : pos(p)
-    , buf(new byte[len + std::min<size_t>(SymmCipher::BLOCKSIZE, RAIDSECTOR)], 0, len)   // SymmCipher::ctr_crypt requirement: decryption: data must be padded to BLOCKSIZE.  Also make sure we can xor up to RAIDSECTOR more for convenience
+    , buf(HttpReq::http_buf_t::allocbuf(len + std::min<size_t>(SymmCipher::BLOCKSIZE, RAIDSECTOR)), 0, len)   // SymmCipher::ctr_crypt requirement: decryption: data must be padded to BLOCKSIZE.  Also make sure we can xor up to RAIDSECTOR more for convenience
 {
 }
 
@@ -178,6 +205,7 @@ void RaidBufferManager::setIsRaid(const std::vector<std::string>& tempUrls, m_of
     assert(!raidKnown);
 
     tempurls = tempUrls;
+    buildAltPortUrls();
 
     is_raid = tempurls.size() == RAIDPARTS;
     raidKnown = true;
@@ -191,7 +219,7 @@ void RaidBufferManager::setIsRaid(const std::vector<std::string>& tempUrls, m_of
     if (is_raid)
     {
         raidpartspos = resumepos / (RAIDPARTS - 1);
-        raidpartspos -= raidpartspos % RAIDSECTOR;
+        raidpartspos &= -RAIDSECTOR;
         resumewastedbytes = size_t(outputfilepos - raidpartspos * (RAIDPARTS - 1));
         outputfilepos -= resumewastedbytes;  // we'll skip over these bytes on the first output
         for (int i = RAIDPARTS; i--; )
@@ -220,6 +248,7 @@ void RaidBufferManager::updateUrlsAndResetPos(const std::vector<std::string>& te
     if (tempurls.size() == tempUrls.size())
     {
         tempurls = tempUrls;
+        buildAltPortUrls();
         if (isRaid())
         {
             for (unsigned i = RAIDPARTS; i--; )
@@ -275,6 +304,66 @@ const std::string& RaidBufferManager::tempURL(unsigned connectionNum)
     }
 }
 
+const std::string& RaidBufferManager::tempURLWithAltPort(unsigned connectionNum)
+{
+    if (isRaid())
+    {
+        assert(connectionNum < tempurlsAltPortShared.size());
+        return *tempurlsAltPortShared[connectionNum];
+    }
+    else if (!tempurlsAltPortShared.empty())
+    {
+        return *tempurlsAltPortShared[0];
+    }
+    else
+    {
+        assert(false); // this class shouldn't be used until we have the URLs, but don't crash
+        return emptyReturnString;
+    }
+}
+
+std::shared_ptr<const std::string> RaidBufferManager::tempURLShared(unsigned connectionNum, bool altPort)
+{
+    const std::vector<std::shared_ptr<const std::string>>& urls = altPort ? tempurlsAltPortShared : tempurlsShared;
+    if (isRaid())
+    {
+        assert(connectionNum < urls.size());
+        return urls[connectionNum];
+    }
+    else if (!urls.empty())
+    {
+        return urls[0];
+    }
+    else
+    {
+        assert(false); // this class shouldn't be used until we have the URLs, but don't crash
+        return std::make_shared<const std::string>();
+    }
+}
+
+// two variants per URL suffice: a given temp URL has one scheme, and the alt-port
+// variant degenerates to the plain one for https or explicit-port URLs
+void RaidBufferManager::buildAltPortUrls()
+{
+    tempurlsShared.clear();
+    tempurlsAltPortShared.clear();
+    for (const std::string& url : tempurls)
+    {
+        tempurlsShared.push_back(std::make_shared<const std::string>(url));
+
+        std::string alt = url;
+        if (!alt.compare(0, 5, "http:"))
+        {
+            size_t index = alt.find("/", 8);
+            if (index != std::string::npos && alt.find(":", 8) == std::string::npos)
+            {
+                alt.insert(index, ":8080");
+            }
+        }
+        tempurlsAltPortShared.push_back(std::make_shared<const std::string>(std::move(alt)));
+    }
+}
+
 const std::vector<std::string>& RaidBufferManager::tempUrlVector() const
 {
     return tempurls;
@@ -476,7 +565,7 @@ void RaidBufferManager::combineRaidParts(unsigned connectionNum)
             (i > 0 ? sumdatalen : xorlen) += r.buf.datalen();
         }
     }
-    partslen -= partslen % RAIDSECTOR; // restrict to raidline boundary
+    partslen &= -RAIDSECTOR; // restrict to raidline boundary
 
     // for correct mac processing, we need to process the output file in pieces delimited by the chunkfloor / chunkceil algorithm
     m_off_t newdatafilepos = outputfilepos + leftoverchunk.buf.datalen();
@@ -730,8 +819,6 @@ bool RaidBufferManager::FilePiece::finalize(bool parallel, m_off_t filesize, int
     }
 
     finalized = !queueParallel;
-    if (finalized)
-        finalizedCV.notify_one();
 
     return queueParallel;
 }
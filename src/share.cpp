@@ -22,6 +22,53 @@
 #include "mega/share.h"
 
 namespace mega {
+
+namespace {
+
+// Shares arrive in bulk with the node tree, so their objects come from slab
+// pools like the nodes that own them.
+SlabPool& shareSlabPool()
+{
+    static SlabPool pool(sizeof(Share));
+    return pool;
+}
+
+SlabPool& newShareSlabPool()
+{
+    static SlabPool pool(sizeof(NewShare));
+    return pool;
+}
+
+} // anonymous namespace
+
+void* Share::operator new(size_t size)
+{
+    assert(size == sizeof(Share));
+    return shareSlabPool().alloc();
+}
+
+void Share::operator delete(void* p)
+{
+    if (p)
+    {
+        shareSlabPool().release(p);
+    }
+}
+
+void* NewShare::operator new(size_t size)
+{
+    assert(size == sizeof(NewShare));
+    return newShareSlabPool().alloc();
+}
+
+void NewShare::operator delete(void* p)
+{
+    if (p)
+    {
+        newShareSlabPool().release(p);
+    }
+}
+
 Share::Share(User* u, accesslevel_t a, m_time_t t, PendingContactRequest* pending)
 {
     user = u;
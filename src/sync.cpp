@@ -6392,7 +6392,7 @@ void SyncRow::inferOrCalculateChildSyncRows(bool wasSynced, vector<SyncRow>& chi
     // (SyncNode = LocalNode, we'll rename LocalNode eventually)
 
     if (wasSynced && !belowRemovedFsNode &&
-        !syncNode->lastFolderScan && syncNode->syncAgain < TREE_ACTION_HERE &&   // if fully matching, we would have removed the fsNode vector to save space
+        !syncNode->rareRO().lastFolderScan && syncNode->syncAgain < TREE_ACTION_HERE &&   // if fully matching, we would have removed the fsNode vector to save space
         syncNode->sync->inferRegeneratableTriplets(cloudChildren, *syncNode, fsInferredChildren, childRows))
     {
         // success, the already sorted and aligned triplets were inferred
@@ -6401,7 +6401,7 @@ void SyncRow::inferOrCalculateChildSyncRows(bool wasSynced, vector<SyncRow>& chi
     else
     {
         // Effective children are from the last scan, if present.
-        vector<FSNode>* effectiveFsChildren = belowRemovedFsNode ? nullptr : syncNode->lastFolderScan.get();
+        vector<FSNode>* effectiveFsChildren = belowRemovedFsNode ? nullptr : syncNode->rareRO().lastFolderScan.get();
 
         if (!effectiveFsChildren)
         {
@@ -7088,7 +7088,11 @@ bool Sync::recursiveSync(SyncRow& row, SyncPath& fullPath, bool belowRemovedClou
         row.syncNode->setScannedFsid(UNDEF, syncs.localnodeByScannedFsid, LocalPath(), FileFingerprint());
         syncHere = row.syncNode->parent ? row.syncNode->parent->scanAgain < TREE_ACTION_HERE : true;
         recurseHere = false;  // If we need to scan, we need the folder to exist first - revisit later
-        row.syncNode->lastFolderScan.reset();
+        if (row.syncNode->rareRO().lastFolderScan)
+        {
+            row.syncNode->rare().lastFolderScan.reset();
+            row.syncNode->trimRareFields();
+        }
         belowRemovedFsNode = true; // this flag will prevent us reconstructing from scannedFingerprint etc
     }
     else
@@ -7512,9 +7516,9 @@ bool Sync::recursiveSync(SyncRow& row, SyncPath& fullPath, bool belowRemovedClou
         // add them to the scan data to avoid re-fingerprinting no the next folder scan
         if (!row.fsAddedSiblings.empty())
         {
-            auto& scan = row.syncNode->lastFolderScan;
-            if (scan && row.syncNode->scanAgain < TREE_ACTION_HERE)
+            if (row.syncNode->rareRO().lastFolderScan && row.syncNode->scanAgain < TREE_ACTION_HERE)
             {
+                auto& scan = row.syncNode->rare().lastFolderScan;
                 scan->reserve(scan->size() + row.fsAddedSiblings.size());
                 for (auto& ptr: row.fsAddedSiblings)
                 {
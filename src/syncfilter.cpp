@@ -522,6 +522,7 @@ void FilterChain::clear()
     mFingerprint = FileFingerprint();
     mSizeFilter.reset();
     mStringFilters.clear();
+    mHasInheritableRules = false;
 }
 
 FilterLoadResult FilterChain::load(FileSystemAccess& fsAccess, const LocalPath& path)
@@ -621,6 +622,16 @@ FilterLoadResult FilterChain::load(FileAccess& fileAccess)
     mStringFilters = std::move(stringFilters);
     mSizeFilter = std::move(sizeFilter);
 
+    mHasInheritableRules = false;
+    for (auto& filter : mStringFilters)
+    {
+        if (filter->inheritable())
+        {
+            mHasInheritableRules = true;
+            break;
+        }
+    }
+
     LOG_info << "New exclusion rules from file are as follows";
     for (auto &e : mStringFilters)
     {
@@ -642,6 +653,11 @@ ExclusionState FilterChain::match(const RemotePathPair& p,
 {
     if (!mLoadSucceeded) return ES_UNKNOWN;
 
+    // No prefilter (bloom or first-byte index) in front of this walk: most
+    // rules are wildcard-leading globs or regexes, sometimes case-insensitive,
+    // so a literal-prefix filter would have to admit nearly every name.
+    // Chains without inheritable rules are already skipped wholesale by the
+    // ancestor walk via hasInheritableRules().
     auto i = mStringFilters.rbegin();
     auto j = mStringFilters.rend();
 
@@ -661,6 +677,12 @@ ExclusionState FilterChain::match(const RemotePathPair& p,
     return ES_UNMATCHED;
 }
 
+bool FilterChain::hasInheritableRules() const
+{
+    // an unloaded chain must still be consulted so it reports ES_UNKNOWN
+    return !mLoadSucceeded || mHasInheritableRules;
+}
+
 ExclusionState FilterChain::match(const m_off_t s) const
 {
     // Sanity.
@@ -113,10 +113,10 @@ Transfer::~Transfer()
         if (type == GET)
         {
 #ifdef ENABLE_SYNC
-            if (auto dl = dynamic_cast<SyncDownload_inClient*>(*it))
+            // only the sync's own transfer classes set syncxfer, so the tag
+            // identifies the type without RTTI
+            if (auto dl = (*it)->syncxfer ? static_cast<SyncDownload_inClient*>(*it) : nullptr)
             {
-                assert((*it)->syncxfer);
-
                 // Keep sync downloads whose Mac failed, so the user can decide to keep them or not
                 if (dl->mError == API_EKEY)
                 {
@@ -344,7 +344,7 @@ Transfer *Transfer::unserialize(MegaClient *client, string *d, transfer_multimap
 
     t->chunkmacs.calcprogress(t->size, t->pos, t->progresscompleted);
 
-    multi_transfers[type].insert(pair<FileFingerprint*, Transfer*>(t.get(), t.get()));
+    multi_transfers[type].emplace(t.get(), t.get());
     return t.release();
 }
 
@@ -910,8 +910,7 @@ void Transfer::complete(TransferDbCommitter& committer)
                 // pass the distribution responsibility to the sync, for sync requested downloads
                 if (f->syncxfer)
                 {
-                    auto dl = dynamic_cast<SyncDownload_inClient*>(f);
-                    assert(dl);
+                    auto dl = static_cast<SyncDownload_inClient*>(f);
                     dl->downloadDistributor = downloadDistributor;
 
                     client->filecachedel(f, &committer);
@@ -1048,16 +1047,15 @@ void Transfer::completefiles()
 #ifdef ENABLE_SYNC
         if (f->syncxfer && type == PUT)
         {
-            if (SyncUpload_inClient* put = dynamic_cast<SyncUpload_inClient*>(f))
-            {
-                // We are about to hand over responsibility for putnodes to the sync
-                // However, if the sync gets shut down before that is sent, or the
-                // operation turns out to be invalidated (eg. uploaded file deleted before putnodes)
-                // then we must inform the app of the final transfer outcome.
-                client->transferBackstop.remember(put->tag, put->selfKeepAlive);
-                wakeSyncs = true;
-                mIsSyncUpload = true; // This will prevent the deletion of file attributes upon Transfer destruction
-            }
+            SyncUpload_inClient* put = static_cast<SyncUpload_inClient*>(f);
+
+            // We are about to hand over responsibility for putnodes to the sync
+            // However, if the sync gets shut down before that is sent, or the
+            // operation turns out to be invalidated (eg. uploaded file deleted before putnodes)
+            // then we must inform the app of the final transfer outcome.
+            client->transferBackstop.remember(put->tag, put->selfKeepAlive);
+            wakeSyncs = true;
+            mIsSyncUpload = true; // This will prevent the deletion of file attributes upon Transfer destruction
         }
 #endif // ENABLE_SYNC
 
@@ -1293,7 +1291,7 @@ void DirectReadNode::schedule(dstime deltads)
 
     if (EVER(deltads))
     {
-        dsdrn_it = client->dsdrns.insert(pair<dstime, DirectReadNode*>(Waiter::ds + deltads, this));
+        dsdrn_it = client->dsdrns.emplace(Waiter::ds + deltads, this);
     }
     else
     {
@@ -1972,7 +1970,7 @@ DirectReadSlot::DirectReadSlot(DirectRead* cdr)
     mMaxChunkSize = static_cast<unsigned>(static_cast<unsigned>(DirectReadSlot::MAX_DELIVERY_CHUNK) / (mReqs.size() == static_cast<unsigned>(RAIDPARTS) ? (static_cast<unsigned>(RAIDPARTS-1)) : mReqs.size()));
     if (mDr->drbuf.isRaid())
     {
-        mMaxChunkSize -= mMaxChunkSize % RAIDSECTOR;
+        mMaxChunkSize &= static_cast<unsigned>(-RAIDSECTOR);
     }
     mMinComparableThroughput = DirectReadSlot::DEFAULT_MIN_COMPARABLE_THROUGHPUT;
     mSlotStartTime = std::chrono::steady_clock::now();
@@ -31,8 +31,42 @@
 #include "mega/raid.h"
 #include "mega/testhooks.h"
 
+#if defined(__linux__) && !defined(__ANDROID__)
+#include <sys/sysinfo.h>
+#elif defined(__APPLE__) && !defined(USE_IOS)
+#include <mach/mach.h>
+#endif
+
 namespace mega {
 
+namespace {
+
+// Tiered download request-size cap from available memory, shared by the
+// per-platform probes in the TransferSlot constructor; the thresholds are
+// the long-standing Windows policy.
+m_off_t pickMaxRequestSize(uint64_t availBytes, m_off_t defaultSize)
+{
+    if (availBytes < 268435456) // 256 MB
+    {
+        return 2097152; // 2 MB
+    }
+    else if (availBytes < 536870912) // 512 MB
+    {
+        return 4194304; // 4 MB
+    }
+    else if (availBytes < 1073741824) // 1024 MB
+    {
+        return 8388608; // 8 MB
+    }
+    return defaultSize;
+}
+
+// below this size a chunk remainder is decrypted inline rather than queued
+// to the worker threads
+const size_t MAX_INLINE_DECRYPT_SIZE = 64 * 1024;
+
+} // anonymous namespace
+
 TransferSlotFileAccess::TransferSlotFileAccess(std::unique_ptr<FileAccess>&& p, Transfer* t)
     : transfer(t)
 {
@@ -88,7 +122,6 @@ TransferSlot::TransferSlot(Transfer* ctransfer)
     retrying = false;
 
     connections = 0;
-    asyncIO = NULL;
     pendingcmd = NULL;
 
     transfer = ctransfer;
@@ -105,50 +138,60 @@ TransferSlot::TransferSlot(Transfer* ctransfer)
     if (GlobalMemoryStatusEx(&statex))
     {
         LOG_debug << "[Windows] RAM stats. Free physical: " << statex.ullAvailPhys << "   Free virtual: " << statex.ullAvailVirtual;
-        if (statex.ullAvailPhys < 1073741824 // 1024 MB
-                || statex.ullAvailVirtual < 1073741824)
-        {
-            if (statex.ullAvailPhys < 536870912 // 512 MB
-                    || statex.ullAvailVirtual < 536870912)
-            {
-                if (statex.ullAvailPhys < 268435456 // 256 MB
-                        || statex.ullAvailVirtual < 268435456)
-                {
-                    maxRequestSize = 2097152; // 2 MB
-                }
-                else
-                {
-                    maxRequestSize = 4194304; // 4 MB
-                }
-            }
-            else
-            {
-                maxRequestSize = 8388608; // 8 MB
-            }
-        }
+        maxRequestSize = pickMaxRequestSize(std::min<uint64_t>(statex.ullAvailPhys, statex.ullAvailVirtual), MAX_REQ_SIZE);
     }
     else
     {
         LOG_warn << "[Windows] Error getting RAM usage info";
     }
+#elif defined(__linux__) && !defined(__ANDROID__)
+    struct sysinfo si;
+    if (!sysinfo(&si))
+    {
+        uint64_t availBytes = (uint64_t(si.freeram) + si.bufferram) * si.mem_unit;
+        LOG_debug << "[Linux] RAM stats. Free physical: " << availBytes;
+        maxRequestSize = pickMaxRequestSize(availBytes, MAX_REQ_SIZE);
+    }
+    else
+    {
+        LOG_warn << "[Linux] Error getting RAM usage info";
+    }
+#elif defined(__APPLE__) && !defined(USE_IOS)
+    vm_statistics64_data_t vmstat;
+    mach_msg_type_number_t count = HOST_VM_INFO64_COUNT;
+    if (host_statistics64(mach_host_self(), HOST_VM_INFO64, reinterpret_cast<host_info64_t>(&vmstat), &count) == KERN_SUCCESS)
+    {
+        uint64_t availBytes = (uint64_t(vmstat.free_count) + vmstat.inactive_count) * uint64_t(vm_page_size);
+        LOG_debug << "[macOS] RAM stats. Free physical: " << availBytes;
+        maxRequestSize = pickMaxRequestSize(availBytes, MAX_REQ_SIZE);
+    }
+    else
+    {
+        LOG_warn << "[macOS] Error getting RAM usage info";
+    }
 #endif
 }
 
 bool TransferSlot::createconnectionsonce()
 {
     // delay creating these until we know if it's raid or non-raid
-    if (!(connections || reqs.size() || asyncIO))
+    if (!(connections || reqs.size() || asyncIO.size()))
     {
         if (transferbuf.tempUrlVector().empty())
         {
             return false;   // too soon, we don't know raid / non-raid yet
         }
 
+        // Parallelism comes from N HTTP/1.1 connections with disjoint ranges.
+        // Multiplexing the ranges as h2 streams on one connection would share
+        // a single congestion window and TLS session, but needs ALPN/h2 on
+        // the storage servers and a transport rework; the per-connection
+        // buffers are the cost until then.
         connections = transferbuf.isRaid() ? RAIDPARTS : (transfer->size > 131072 ? transfer->client->connections[transfer->type] : 1);
         LOG_debug << "Populating transfer slot with " << connections << " connections, max request size of " << maxRequestSize << " bytes";
         reqs.resize(connections);
         mReqSpeeds.resize(connections);
-        asyncIO = new AsyncIOContext*[connections]();
+        asyncIO.resize(connections);
     }
     return true;
 }
@@ -158,6 +201,13 @@ bool TransferSlot::createconnectionsonce()
 TransferSlot::~TransferSlot()
 {
     LOG_verbose << "Deleting TransferSlot";
+
+    if (mCacheAddPending && !transfer->finished)
+    {
+        // chunk progress coalesced in the last doio() pass that didn't reach its flush point
+        mCacheAddPending = false;
+        transfer->client->transfercacheadd(transfer, nullptr);
+    }
     if (transfer->type == GET && !transfer->finished
             && transfer->progresscompleted != transfer->size
             && !transfer->asyncopencontext)
@@ -216,10 +266,14 @@ TransferSlot::~TransferSlot()
                     case REQ_DECRYPTING:
                     {
                         LOG_info << "[TransferSlot::~TransferSlot] Conn " << i << " : Waiting for block decryption";
-                        std::mutex finalizedMutex;
-                        std::unique_lock<std::mutex> guard(finalizedMutex);
                         auto outputPiece = transferbuf.getAsyncOutputBufferPointer(i);
-                        outputPiece->finalizedCV.wait(guard, [&](){ return outputPiece->finalized; });
+                        // the decryption thread is already working on this piece and will set
+                        // the atomic flag when done; just yield until then rather than
+                        // manufacturing a mutex for a condition_variable no one else locks
+                        while (!outputPiece->finalized)
+                        {
+                            std::this_thread::yield();
+                        }
                         downloadRequest->status = REQ_DECRYPTED;
                         break;
                     }
@@ -230,34 +284,29 @@ TransferSlot::~TransferSlot()
             }
         }
 
-        bool anyData = true;
-        while (anyData)
+        // set up the temporary cipher once for all remaining pieces, and drain
+        // each connection completely before moving to the next, rather than
+        // re-polling every connection (and re-keying the cipher) per piece
+        SymmCipher* cipher = transfer->client->getRecycledTemporaryTransferCipher(transfer->transferkey.data());
+        for (int i = 0; i < connections; ++i)
         {
-            anyData = false;
-            for (int i = 0; i < connections; ++i)
+            // synchronous writes for all remaining outstanding data (for raid, there can be a sequence of output pieces.  for non-raid, one piece per connection)
+            while (auto outputPiece = transferbuf.getAsyncOutputBufferPointer(i))
             {
-                // synchronous writes for all remaining outstanding data (for raid, there can be a sequence of output pieces.  for non-raid, one piece per connection)
-                // check each connection first and then all that were not yet on a connection
-                auto outputPiece = transferbuf.getAsyncOutputBufferPointer(i);
-                if (outputPiece)
+                if (!outputPiece->finalized)
                 {
-                    if (!outputPiece->finalized)
-                    {
-                        SymmCipher *cipher = transfer->client->getRecycledTemporaryTransferCipher(transfer->transferkey.data());
-                        outputPiece->finalize(true, transfer->size, transfer->ctriv, cipher, &transfer->chunkmacs);
-                    }
-                    anyData = true;
-                    if (fa && fa->fwrite(outputPiece->buf.datastart(), static_cast<unsigned>(outputPiece->buf.datalen()), outputPiece->pos))
-                    {
-                        LOG_verbose << "[TransferSlot::~TransferSlot] Conn " << i << " : Sync write succeeded (size: " << outputPiece->buf.datalen() << ")";
-                        transferbuf.bufferWriteCompleted(i, true);
-                        cachetransfer = true;
-                    }
-                    else
-                    {
-                        LOG_err << "[TransferSlot::~TransferSlot] Conn " << i << " : Error caching data at: " << outputPiece->pos << " (size: " << outputPiece->buf.datalen() << ")";
-                        transferbuf.bufferWriteCompleted(i, false);  // throws the data away so we can move on to the next one
-                    }
+                    outputPiece->finalize(true, transfer->size, transfer->ctriv, cipher, &transfer->chunkmacs);
+                }
+                if (fa && fa->fwrite(outputPiece->buf.datastart(), static_cast<unsigned>(outputPiece->buf.datalen()), outputPiece->pos))
+                {
+                    LOG_verbose << "[TransferSlot::~TransferSlot] Conn " << i << " : Sync write succeeded (size: " << outputPiece->buf.datalen() << ")";
+                    transferbuf.bufferWriteCompleted(i, true);
+                    cachetransfer = true;
+                }
+                else
+                {
+                    LOG_err << "[TransferSlot::~TransferSlot] Conn " << i << " : Error caching data at: " << outputPiece->pos << " (size: " << outputPiece->buf.datalen() << ")";
+                    transferbuf.bufferWriteCompleted(i, false);  // throws the data away so we can move on to the next one
                 }
             }
         }
@@ -298,19 +347,18 @@ TransferSlot::~TransferSlot()
     {
         delete asyncIO[connections];
     }
-
-    delete[] asyncIO;
 }
 
 void TransferSlot::toggleport(HttpReqXfer *req)
 {
-    if (!memcmp(req->posturl.c_str(), "http:", 5))
+    if (req->isHttp)
     {
        size_t portendindex = req->posturl.find("/", 8);
-       size_t portstartindex = req->posturl.find(":", 8);
 
        if (portendindex != string::npos)
        {
+           size_t portstartindex = req->posturl.find(":", 8);
+
            if (portstartindex == string::npos)
            {
                LOG_debug << "Enabling alternative port for chunk";
@@ -342,11 +390,6 @@ int64_t TransferSlot::macsmac(chunkmac_map* m)
     return m->macsmac(transfer->transfercipher());
 }
 
-int64_t TransferSlot::macsmac_gaps(chunkmac_map* m, size_t g1, size_t g2, size_t g3, size_t g4)
-{
-    return m->macsmac_gaps(transfer->transfercipher(), g1, g2, g3, g4);
-}
-
 bool TransferSlot::checkMetaMacWithMissingLateEntries()
 {
     // Due to an old bug, some uploads attached a MAC to the node that was missing some MAC entries
@@ -359,13 +402,23 @@ bool TransferSlot::checkMetaMacWithMissingLateEntries()
     size_t end = transfer->chunkmacs.size();
     size_t finalN = std::min<size_t>(32 * 3, end);
 
+    // the search below probes thousands of candidate gaps; precompute the
+    // chain prefix states once so each candidate only re-encrypts the entries
+    // after its first gap, rather than re-running the whole chain every time.
+    // (no cheaper pruning is possible: the chain is AES, so a candidate's
+    // final MAC bears no computable relation to any partial state or to the
+    // delta against the full MAC until the remaining blocks are encrypted)
+    SymmCipher* cipher = transfer->transfercipher();
+    chunkmac_map::MacsmacState state;
+    transfer->chunkmacs.buildMacsmacState(cipher, state);
+
     // first check for the most likely - a single connection gap (or two but completely consecutive making a single gap)
     for (size_t countBack = 1; countBack <= finalN; ++countBack)
     {
         size_t start1 = end - countBack;
         for (size_t len1 = 1; len1 <= 64 && start1 + len1 <= end; ++len1)
         {
-            if (transfer->metamac == macsmac_gaps(&transfer->chunkmacs, start1, start1 + len1, end, end))
+            if (transfer->metamac == state.macWithGaps(cipher, start1, start1 + len1, end, end))
             {
                 LOG_warn << "Found mac gaps were at " << start1 << " " << len1 << " from " << end;
                 auto correctMac = macsmac(&transfer->chunkmacs);
@@ -378,17 +431,31 @@ bool TransferSlot::checkMetaMacWithMissingLateEntries()
 
     // now check for two separate pieces missing (much less likely)
     // limit to checking up to 16Mb pieces wtih up to 8Mb between to avoid excessive CPU
-    // takes about 1 second on a fairly modest laptop for a 100Mb file (in a release build)
     finalN = std::min<size_t>(16 * 2 + 8, transfer->chunkmacs.size());
     for (size_t start1 = end - finalN; start1 < end; ++start1)
     {
         for (size_t len1 = 1; len1 <= 16 && start1 + len1 <= end; ++len1)
         {
+            // state after skipping the first gap, advanced one entry at a
+            // time as start2 walks forward, so only the tail after the
+            // second gap is re-encrypted per candidate
+            byte middle[SymmCipher::BLOCKSIZE];
+            memcpy(middle, state.states[state.entryAt(start1)].data(), sizeof middle);
+            size_t folded = state.entryAt(start1 + len1);
+
             for (size_t start2 = start1 + len1 + 1; start2 < transfer->chunkmacs.size(); ++start2)
             {
+                size_t c = state.entryAt(start2);
+                state.fold(cipher, folded, c, middle);
+                folded = c;
+
                 for (size_t len2 = 1; len2 <= 16 && start2 + len2 <= end; ++len2)
                 {
-                    if (transfer->metamac == macsmac_gaps(&transfer->chunkmacs, start1, start1 + len1, start2, start2 + len2))
+                    byte mac[SymmCipher::BLOCKSIZE];
+                    memcpy(mac, middle, sizeof mac);
+                    state.fold(cipher, state.entryAt(start2 + len2), state.macs.size(), mac);
+
+                    if (transfer->metamac == chunkmac_map::MacsmacState::metamac(mac))
                     {
                         LOG_warn << "Found mac gaps were at " << start1 << " " << len1 << " " << start2 << " " << len2 << " from " << end;
                         auto correctMac = macsmac(&transfer->chunkmacs);
@@ -403,11 +470,13 @@ bool TransferSlot::checkMetaMacWithMissingLateEntries()
     return false;
 }
 
-bool TransferSlot::checkDownloadTransferFinished(TransferDbCommitter& committer, MegaClient* client)
+bool TransferSlot::checkDownloadTransferFinished(TransferDbCommitter& committer, MegaClient* client, bool cachedDownload)
 {
     if (transfer->progresscompleted == transfer->size)
     {
         // verify meta MAC
+        // (a single 64-bit compare: no byte-by-byte early exit to leak
+        // timing, and both values are already local to this client)
         if (!transfer->size
             || (macsmac(&transfer->chunkmacs) == transfer->metamac)
             || checkMetaMacWithMissingLateEntries())
@@ -425,7 +494,9 @@ bool TransferSlot::checkDownloadTransferFinished(TransferDbCommitter& committer,
         }
         else
         {
-            client->sendevent(99431, "MAC verification failed", 0);
+            client->sendevent(cachedDownload ? 99432 : 99431,
+                              cachedDownload ? "MAC verification failed for cached download"
+                                             : "MAC verification failed", 0);
             transfer->chunkmacs.clear();
             transfer->failed(API_EKEY, committer);
         }
@@ -434,6 +505,21 @@ bool TransferSlot::checkDownloadTransferFinished(TransferDbCommitter& committer,
     return false;
 }
 
+int TransferSlot::unparkDownloadChunk()
+{
+    auto it = mParkedChunks.find(transfer->progresscompleted);
+    if (it == mParkedChunks.end())
+    {
+        return -1;
+    }
+
+    unsigned connection = it->second;
+    mParkedChunks.erase(it);
+    assert(reqs[connection] && reqs[connection]->status == REQ_PARKED);
+    reqs[connection]->status = REQ_SUCCESS;
+    return int(connection);
+}
+
 bool TransferSlot::testForSlowRaidConnection(unsigned connectionNum, bool& incrementErrors)
 {
     if (transfer->type == GET && transferbuf.isRaid())
@@ -503,18 +589,10 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
             if (fa && transfer->type == GET)
             {
                 LOG_debug << "Verifying cached download";
-                // verify meta MAC
-                if (macsmac(&transfer->chunkmacs) == transfer->metamac)
-                {
-                    return transfer->complete(committer);
-                }
-                else
-                {
-                    client->sendevent(99432, "MAC verification failed for cached download", 0);
-
-                    transfer->chunkmacs.clear();
-                    return transfer->failed(API_EKEY, committer);
-                }
+                // same verification (including the late-gap corrective
+                // check) and completion handling as the live download path
+                checkDownloadTransferFinished(committer, client, true);
+                return;
             }
 
             // this is a pending completion, retry every 200 ms by default
@@ -551,6 +629,11 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
     }
 
     // main loop over connections
+    // (the per-connection state stays on the HttpReq objects rather than in a packed
+    // side array: status is written from network-backend callbacks and from the
+    // mAsyncQueue workers, so a mirrored copy - or a packed status word to scan for
+    // ready connections - would need its own synchronisation at every transition,
+    // and with at most 6 connections the handful of touched cachelines stays hot anyway)
     for (int i = connections; i--; )
     {
         if (reqs[i])
@@ -572,7 +655,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                 LOG_debug << "Connection " << i << " received " << downloadRequest->bufpos << " before failing, processing data.";
                 if (downloadRequest->contentlength == downloadRequest->size && downloadRequest->bufpos >= RAIDSECTOR)
                 {
-                    downloadRequest->bufpos -= downloadRequest->bufpos % RAIDSECTOR;  // always on a raidline boundary
+                    downloadRequest->bufpos &= -RAIDSECTOR;  // always on a raidline boundary
                     downloadRequest->size = unsigned(downloadRequest->bufpos);
                     transferbuf.transferPos(i) = downloadRequest->bufpos;
                     downloadRequest->status = REQ_SUCCESS;
@@ -583,10 +666,13 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
             {
                 case REQ_INFLIGHT:
                 {
-                    m_off_t delta = mReqSpeeds[i].requestProgressed(reqs[i]->transferred(client));
+                    // one transferred() query per tick; for uploads it asks
+                    // the HTTP layer for the current post position
+                    m_off_t transferredNow = reqs[i]->transferred(client);
+                    m_off_t delta = mReqSpeeds[i].requestProgressed(transferredNow);
                     mTransferSpeed.calculateSpeed(delta);
 
-                    p += reqs[i]->transferred(client);
+                    p += transferredNow;
 
                     assert(reqs[i]->lastdata != NEVER);
                     bool incrementErrors = false;
@@ -617,7 +703,10 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
 
                     if (client->orderdownloadedchunks && transfer->type == GET && !transferbuf.isRaid() && transfer->progresscompleted != static_cast<HttpReqDL*>(reqs[i].get())->dlpos)
                     {
-                        // postponing unsorted chunk
+                        // park the unsorted chunk; unparkDownloadChunk revisits it directly
+                        // once progresscompleted reaches it, instead of rechecking every tick
+                        mParkedChunks[static_cast<HttpReqDL*>(reqs[i].get())->dlpos] = unsigned(i);
+                        reqs[i]->status = REQ_PARKED;
                         p += reqs[i]->size;
                         break;
                     }
@@ -723,8 +812,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                                 break;
                             }
 
-                            if (e == DAEMON_EFAILED || (reqs[i]->contenttype.find("text/html") != string::npos
-                                    && !memcmp(reqs[i]->posturl.c_str(), "http:", 5)))
+                            if (e == DAEMON_EFAILED || (reqs[i]->contentTypeIsHtml && reqs[i]->isHttp))
                             {
                                 client->usehttps = true;
                                 client->app->notify_change_to_https();
@@ -765,7 +853,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
 
                         errorcount = 0;
                         transfer->failcount = 0;
-                        client->transfercacheadd(transfer, &committer);
+                        mCacheAddPending = true;
                         reqs[i]->status = REQ_READY;
 
                         DEBUG_TEST_HOOK_UPLOADCHUNK_SUCCEEDED(transfer, committer);  // this will return if the hook returns false
@@ -807,9 +895,18 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                                 mRaidChannelSwapsForSlowness = 0;
                                 bool parallelNeeded = outputPiece->finalize(false, transfer->size, transfer->ctriv, transfer->transfercipher(), &transfer->chunkmacs);
 
-                                if (parallelNeeded)
+                                if (parallelNeeded && outputPiece->buf.datalen() <= MAX_INLINE_DECRYPT_SIZE)
+                                {
+                                    // small remainder: the queue round trip (enqueue, worker wakeup,
+                                    // cipher rekey) costs more than decrypting it right here
+                                    outputPiece->finalize(true, transfer->size, transfer->ctriv, transfer->transfercipher(), nullptr);
+                                    reqs[i]->status = REQ_DECRYPTED;
+                                }
+                                else if (parallelNeeded)
                                 {
                                     // do full chunk (and chunk-remainder) decryption on a thread for throughput and to minimize mutex lock times.
+                                    // (the two refcount ops per job are noise next to the AES work;
+                                    // the shared_ptr is what keeps the req alive through shutdown)
                                     auto req = reqs[i];   // shared_ptr for shutdown safety
                                     auto transferkey = transfer->transferkey;
                                     auto ctriv = transfer->ctriv;
@@ -840,8 +937,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                         }
                         else
                         {
-                            if (reqs[i]->contenttype.find("text/html") != string::npos
-                                    && !memcmp(reqs[i]->posturl.c_str(), "http:", 5))
+                            if (reqs[i]->contentTypeIsHtml && reqs[i]->isHttp)
                             {
                                 LOG_warn << "Conn " << i << " : Invalid Content-Type detected during download: " << reqs[i]->contenttype;
                                 client->usehttps = true;
@@ -868,6 +964,13 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                     assert(transfer->type == PUT);
                     break;
                 }
+                case REQ_PARKED:
+                {
+                    assert(transfer->type == GET);
+                    // downloaded, waiting for earlier chunks to be written; still counts towards progress
+                    p += reqs[i]->size;
+                    break;
+                }
                 case REQ_DECRYPTING:
                 {
                     assert(transfer->type == GET);
@@ -881,6 +984,10 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                     {
                         assert(transfer->type == GET);
 
+                        // each piece is written on its own: pieces from different connections are
+                        // rarely file-adjacent at the same tick, and bufferWriteCompleted advances
+                        // per-connection and per-piece state that a merged write could not attribute
+
                         // this must return the same piece we just decrypted, since we have not asked the transferbuf to discard it yet.
                         auto outputPiece = transferbuf.getAsyncOutputBufferPointer(i);
 
@@ -904,6 +1011,10 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                             if (fa->fwrite(outputPiece->buf.datastart(), static_cast<unsigned>(outputPiece->buf.datalen()), outputPiece->pos))
                             {
                                 LOG_verbose << "Conn " << i << " : Sync write succeeded (size: " << outputPiece->buf.datalen() << ")";
+                                if (client->dropwrittenchunkcache)
+                                {
+                                    fa->fadviseDontNeed(outputPiece->pos, m_off_t(outputPiece->buf.datalen()));
+                                }
                                 transferbuf.bufferWriteCompleted(i, true);
                                 errorcount = 0;
                                 transfer->failcount = 0;
@@ -927,8 +1038,17 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                                 return;
                             }
 
-                            client->transfercacheadd(transfer, &committer);
+                            mCacheAddPending = true;
                             reqs[i]->status = REQ_READY;
+
+                            int parked = unparkDownloadChunk();
+                            if (parked > i)
+                            {
+                                // revisit the now in-order chunk straight away
+                                // (parked chunks below i are reached by the rest of this scan)
+                                i = parked + 1;
+                                continue;
+                            }
                         }
                     }
                     break;
@@ -943,15 +1063,9 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                             {
                                 LOG_verbose << "Conn " << i << " : Async read succeeded (size: " << asyncIO[i]->dataBufferLen << ")";
                                 m_off_t npos = asyncIO[i]->posOfBuffer + asyncIO[i]->dataBufferLen;
-                                string finaltempurl = transferbuf.tempURL(i);
-                                if (client->usealtupport && !memcmp(finaltempurl.c_str(), "http:", 5))
-                                {
-                                    size_t index = finaltempurl.find("/", 8);
-                                    if(index != string::npos && finaltempurl.find(":", 8) == string::npos)
-                                    {
-                                        finaltempurl.insert(index, ":8080");
-                                    }
-                                }
+                                // shared reference to the prebuilt URL variant - no copy per chunk, and it
+                                // stays valid even if this slot is torn down before the job runs
+                                auto finaltempurl = transferbuf.tempURLShared(i, client->usealtupport);
 
                                 auto pos = asyncIO[i]->posOfBuffer;
                                 auto req = reqs[i];    // shared_ptr so no object is deleted out from under the worker
@@ -963,13 +1077,17 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                                 client->mAsyncQueue.push([req, transferkey, ctriv, finaltempurl, pos, npos](SymmCipher& sc)
                                     {
                                         sc.setkey(transferkey.data());
-                                        req->prepare(finaltempurl.c_str(), &sc, ctriv, pos, npos);
+                                        req->prepare(finaltempurl->c_str(), &sc, ctriv, pos, npos);
                                         req->status = REQ_PREPARED;
                                     }, true);   // discardable - if the transfer or client are being destroyed, we won't be sending that data.
                             }
                             else
                             {
                                 LOG_verbose << "Conn " << i << " : Async write succeeded (size: " << asyncIO[i]->dataBufferLen << ")";
+                                if (client->dropwrittenchunkcache)
+                                {
+                                    fa->fadviseDontNeed(asyncIO[i]->posOfBuffer, m_off_t(asyncIO[i]->dataBufferLen));
+                                }
                                 transferbuf.bufferWriteCompleted(i, true);
                                 errorcount = 0;
                                 transfer->failcount = 0;
@@ -981,16 +1099,21 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                                     return;
                                 }
 
-                                client->transfercacheadd(transfer, &committer);
+                                mCacheAddPending = true;
                                 reqs[i]->status = REQ_READY;
 
                                 if (client->orderdownloadedchunks && !transferbuf.isRaid())
                                 {
-                                    // Check connections again looking for postponed chunks
-                                    delete asyncIO[i];
-                                    asyncIO[i] = NULL;
-                                    i = connections;
-                                    continue;
+                                    // resume the specific parked chunk that is now in order,
+                                    // if any, rather than rescanning every connection
+                                    int parked = unparkDownloadChunk();
+                                    if (parked > i)
+                                    {
+                                        delete asyncIO[i];
+                                        asyncIO[i] = NULL;
+                                        i = parked + 1;
+                                        continue;
+                                    }
                                 }
                             }
                             delete asyncIO[i];
@@ -1040,7 +1163,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                     break;
 
                 default:
-                    ;
+                    ;   // no case above falls through into this default
             }
         }
 
@@ -1073,6 +1196,9 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
 
                     if (!reqs[i])
                     {
+                        // allocated once per connection and recycled for every subsequent
+                        // chunk: the out buffer keeps its capacity across chunks, and the
+                        // upload chunkmac map is cleared below rather than reallocated
                         reqs[i].reset(transfer->type == PUT ? (HttpReqXfer*)new HttpReqUL() : (HttpReqXfer*)new HttpReqDL());
                         reqs[i]->logname = client->clientname + (transfer->type == PUT ? "U" : "D") + std::to_string(++client->transferHttpCounter) + " ";
                     }
@@ -1123,7 +1249,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
 
                     if (prepare)
                     {
-                        prepareRequest(reqs[i], transferbuf.tempURL(i), posrange.first, posrange.second);
+                        prepareRequest(reqs[i], unsigned(i), posrange.first, posrange.second);
                     }
 
                     LOG_verbose << "Conn " << i << " : Request prepared. Pos: " << posrange.first << " to npos: " << posrange.second << ". Size: " << (posrange.second - posrange.first) << ""
@@ -1152,6 +1278,15 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
         }
     }
 
+    if (mCacheAddPending)
+    {
+        // flush the coalesced per-chunk progress in one serialisation; the committer
+        // already batches the SQLite transaction, this just stops re-serialising the
+        // same Transfer for every chunk completed within it
+        mCacheAddPending = false;
+        client->transfercacheadd(transfer, &committer);
+    }
+
     if (transfer->type == PUT)
     {
         // Get the number of reqs in flight and the position of the earliest for...
@@ -1242,6 +1377,8 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
         failure = true;
         bool changeport = false;
 
+        // per-request scheme checks are cached in HttpReq::isHttp; these two only run
+        // on a transfer timeout, so comparing the scheme inline here is fine
         if (transfer->type == GET && client->autodownport && !memcmp(transferbuf.tempURL(0).c_str(), "http:", 5))
         {
             LOG_debug << "Automatically changing download port due to a timeout";
@@ -1352,19 +1489,13 @@ m_off_t TransferSlot::updatecontiguousprogress()
 }
 
 
-void TransferSlot::prepareRequest(const std::shared_ptr<HttpReqXfer>& httpReq, const string& tempURL, m_off_t pos, m_off_t npos)
+void TransferSlot::prepareRequest(const std::shared_ptr<HttpReqXfer>& httpReq, unsigned connectionNum, m_off_t pos, m_off_t npos)
 {
-    string finaltempURL = tempURL;
-    if (((transfer->type == GET && transfer->client->usealtdownport) ||
-        (transfer->type == PUT && transfer->client->usealtupport)) &&
-            !memcmp(finaltempURL.c_str(), "http:", 5))
-    {
-        size_t index = finaltempURL.find("/", 8);
-        if (index != string::npos && finaltempURL.find(":", 8) == string::npos)
-        {
-            finaltempURL.insert(index, ":8080");
-        }
-    }
+    // the alt-port variant is prebuilt by the buffer manager, so no URL parsing or copy here
+    const string& finaltempURL = ((transfer->type == GET && transfer->client->usealtdownport) ||
+                                  (transfer->type == PUT && transfer->client->usealtupport))
+                                     ? transferbuf.tempURLWithAltPort(connectionNum)
+                                     : transferbuf.tempURL(connectionNum);
 
     httpReq->prepare(finaltempURL.c_str(),
                      transfer->transfercipher(),
@@ -1378,7 +1509,7 @@ std::pair<error, dstime> TransferSlot::processRequestFailure(MegaClient* client,
 {
     LOG_warn << "Conn " << channel << " : Failed chunk. HTTP status: " << httpReq->httpstatus;
 
-    if (httpReq->httpstatus && httpReq->contenttype.find("text/html") != string::npos && !memcmp(httpReq->posturl.c_str(), "http:", 5))
+    if (httpReq->httpstatus && httpReq->contentTypeIsHtml && httpReq->isHttp)
     {
         LOG_warn << "Conn " << channel << " : Invalid Content-Type detected on failed chunk: " << httpReq->contenttype;
         client->usehttps = true;
@@ -1431,13 +1562,13 @@ std::pair<error, dstime> TransferSlot::processRequestFailure(MegaClient* client,
             failure = true;
             bool changeport = false;
 
-            if (transfer->type == GET && client->autodownport && !memcmp(httpReq->posturl.c_str(), "http:", 5))
+            if (transfer->type == GET && client->autodownport && httpReq->isHttp)
             {
                 LOG_debug << "Conn " << channel << " : Automatically changing download port";
                 client->usealtdownport = !client->usealtdownport;
                 changeport = true;
             }
-            else if (transfer->type == PUT && client->autoupport && !memcmp(httpReq->posturl.c_str(), "http:", 5))
+            else if (transfer->type == PUT && client->autoupport && httpReq->isHttp)
             {
                 LOG_debug << "Conn " << channel << " : Automatically changing upload port";
                 client->usealtupport = !client->usealtupport;
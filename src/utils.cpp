@@ -642,6 +642,11 @@ void chunkmac_map::debugLogOuputMacs()
 }
 
 // coalesce block macs into file mac
+// (ecb_encrypt resolves to Crypto++'s Rijndael, which already selects
+// AES-NI at runtime on capable CPUs; no separate dispatch needed here.
+// The entries are map nodes, not a contiguous array, so there is no fixed
+// stride to software-prefetch - and the leading-entry collapse keeps this
+// sweep to the uncollapsed tail anyway)
 int64_t chunkmac_map::macsmac(SymmCipher *cipher)
 {
     byte mac[SymmCipher::BLOCKSIZE] = { 0 };
@@ -669,15 +674,25 @@ int64_t chunkmac_map::macsmac(SymmCipher *cipher)
     return MemAccess::get<int64_t>((const char*)mac);
 }
 
-int64_t chunkmac_map::macsmac_gaps(SymmCipher *cipher, size_t g1, size_t g2, size_t g3, size_t g4)
+void chunkmac_map::buildMacsmacState(SymmCipher* cipher, MacsmacState& state) const
 {
     byte mac[SymmCipher::BLOCKSIZE] = { 0 };
 
+    state.states.clear();
+    state.positions.clear();
+    state.macs.clear();
+    state.states.reserve(mMacMap.size() + 1);
+    state.positions.reserve(mMacMap.size());
+    state.macs.reserve(mMacMap.size());
+
     size_t n = 0;
     for (auto it = mMacMap.begin(); it != mMacMap.end(); it++, n++)
     {
         if (it->second.isMacsmacSoFar())
         {
+            // the collapsed leading record stands in for all chunks up to its
+            // position and is never a gap candidate; it resets the chain state
+            assert(it == mMacMap.begin());
             memcpy(mac, it->second.mac, sizeof(mac));
             for (m_off_t pos = 0; pos <= it->first; pos = ChunkedHash::chunkceil(pos))
             {
@@ -686,20 +701,59 @@ int64_t chunkmac_map::macsmac_gaps(SymmCipher *cipher, size_t g1, size_t g2, siz
         }
         else
         {
-            if ((n >= g1 && n < g2) || (n >= g3 && n < g4)) continue;
-
             assert(it->first == ChunkedHash::chunkfloor(it->first));
+            state.positions.push_back(n);
+            state.macs.push_back(it->second.mac);
+            state.states.emplace_back();
+            memcpy(state.states.back().data(), mac, sizeof(mac));
             SymmCipher::xorblock(it->second.mac, mac);
             cipher->ecb_encrypt(mac);
         }
     }
 
-    uint32_t* m = (uint32_t*)mac;
+    state.states.emplace_back();
+    memcpy(state.states.back().data(), mac, sizeof(mac));
+}
+
+size_t chunkmac_map::MacsmacState::entryAt(size_t g) const
+{
+    return static_cast<size_t>(std::lower_bound(positions.begin(), positions.end(), g) - positions.begin());
+}
+
+// Each fold is a serial CBC chain, latency-bound on the AES unit.  Probing
+// several gap hypotheses in interleaved lockstep could hide that latency,
+// but all AES here goes through SymmCipher (Crypto++), which does not expose
+// round keys for hand-scheduled multi-state encryption, and the incremental
+// search above already removed the bulk of the work.
+void chunkmac_map::MacsmacState::fold(SymmCipher* cipher, size_t from, size_t to, byte* mac) const
+{
+    for (size_t i = from; i < to; i++)
+    {
+        SymmCipher::xorblock(macs[i], mac);
+        cipher->ecb_encrypt(mac);
+    }
+}
+
+int64_t chunkmac_map::MacsmacState::metamac(const byte* mac)
+{
+    uint32_t m[4];
+    memcpy(m, mac, sizeof(m));
 
     m[0] ^= m[1];
     m[1] = m[2] ^ m[3];
 
-    return MemAccess::get<int64_t>((const char*)mac);
+    return MemAccess::get<int64_t>((const char*)m);
+}
+
+int64_t chunkmac_map::MacsmacState::macWithGaps(SymmCipher* cipher, size_t g1, size_t g2, size_t g3, size_t g4) const
+{
+    byte mac[SymmCipher::BLOCKSIZE];
+    memcpy(mac, states[entryAt(g1)].data(), sizeof(mac));
+
+    fold(cipher, entryAt(g2), entryAt(g3), mac);
+    fold(cipher, entryAt(g4), macs.size(), mac);
+
+    return metamac(mac);
 }
 
 bool CacheableReader::unserializechunkmacs(chunkmac_map& m)
@@ -1261,6 +1315,41 @@ int mega_snprintf(char *s, size_t n, const char *format, ...)
 }
 #endif
 
+SlabPool::~SlabPool()
+{
+    for (void* slab : slabs)
+    {
+        ::operator delete(slab);
+    }
+}
+
+void* SlabPool::alloc()
+{
+    std::lock_guard<std::mutex> g(m);
+    if (!freeHead)
+    {
+        char* base = static_cast<char*>(::operator new(slotSize * SLOTS_PER_SLAB));
+        slabs.push_back(base);
+        for (size_t i = SLOTS_PER_SLAB; i--; )
+        {
+            FreeSlot* slot = reinterpret_cast<FreeSlot*>(base + i * slotSize);
+            slot->next = freeHead;
+            freeHead = slot;
+        }
+    }
+    FreeSlot* slot = freeHead;
+    freeHead = slot->next;
+    return slot;
+}
+
+void SlabPool::release(void* p)
+{
+    std::lock_guard<std::mutex> g(m);
+    FreeSlot* slot = static_cast<FreeSlot*>(p);
+    slot->next = freeHead;
+    freeHead = slot;
+}
+
 string * TLVstore::tlvRecordsToContainer(PrnGen &rng, SymmCipher *key, encryptionsetting_t encSetting)
 {
     // decide nonce/IV and auth. tag lengths based on the `mode`
@@ -2651,6 +2740,10 @@ void MegaClientAsyncQueue::push(std::function<void(SymmCipher&)> f, bool discard
     }
     else
     {
+        // A mutex-protected deque is enough here: jobs arrive per transfer chunk, not
+        // per block, so the lock is held for an emplace every few megabytes of work.
+        // The wake-up is signalled outside the lock to keep the woken worker from
+        // immediately blocking on it.
         {
             std::lock_guard<std::mutex> g(mMutex);
             mQueue.emplace_back(discardable, std::move(f));
@@ -2659,6 +2752,10 @@ void MegaClientAsyncQueue::push(std::function<void(SymmCipher&)> f, bool discard
     }
 }
 
+// One shared queue, unpinned threads.  Sharding by connection with per-core
+// affinity would keep a decrypted buffer in the cache of the core that wrote it,
+// but the buffer is consumed by the app/filesystem thread anyway, and pinning
+// threads is not something a library embedded in arbitrary apps should do.
 MegaClientAsyncQueue::MegaClientAsyncQueue(Waiter& w, unsigned threadCount)
     : mWaiter(w)
 {
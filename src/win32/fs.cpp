@@ -1845,7 +1845,7 @@ bool  WinFileSystemAccess::checkForSymlink(const LocalPath& lp)
     return false;
 }
 
-ScanResult WinFileSystemAccess::directoryScan(const LocalPath& path, handle expectedFsid, map<LocalPath, FSNode>& known, std::vector<FSNode>& results, bool followSymLinks, unsigned& nFingerprinted)
+ScanResult WinFileSystemAccess::directoryScan(const LocalPath& path, handle expectedFsid, fsnode_map& known, std::vector<FSNode>& results, bool followSymLinks, unsigned& nFingerprinted)
 {
     assert(path.isAbsolute());
     assert(!followSymLinks && "Symlinks are not supported on Windows!");